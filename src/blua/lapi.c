@@ -885,6 +885,15 @@ LUA_API int  lua_status (lua_State *L) {
 }
 
 
+/*
+** SRB2: whether lua_yield can be called right now, i.e. there's no
+** C call or metamethod between the running code and the resume.
+*/
+LUA_API int  lua_isyieldable (lua_State *L) {
+  return L->nCcalls <= L->baseCcalls;
+}
+
+
 /*
 ** Garbage-collection function
 */
@@ -933,7 +933,16 @@ static void D_RunFrame(void)
 		HW3S_EndFrameUpdate();
 #endif
 
-		LUA_Step();
+		// Let Lua's collector use some of the time the frame cap would sleep away.
+		{
+			INT64 elapsed = (INT64)(I_GetPreciseTime() - enterprecise);
+			const boolean vsync_with_match_refresh = cv_vidwait.value && cv_fpscap.value == 0;
+
+			if (!singletics && elapsed > 0 && (INT64)capbudget > elapsed && !vsync_with_match_refresh)
+				LUA_Step(capbudget - (precise_t)elapsed);
+			else
+				LUA_Step(0);
+		}
 
 		// Fully completed frame made.
 		finishprecise = I_GetPreciseTime();
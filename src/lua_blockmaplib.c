@@ -14,6 +14,7 @@
 #include "p_local.h"
 #include "r_main.h" // validcount
 #include "p_polyobj.h"
+#include "z_zone.h"
 #include "lua_script.h"
 #include "lua_libs.h"
 //#include "lua_hud.h" // hud_running errors
@@ -328,8 +329,242 @@ static int lib_searchBlockmap(lua_State *L)
 	return 1;
 }
 
+//
+// searchMobjs
+//
+// searchBlockmap calls back into Lua for every thing in the box, which is
+// most of the cost when a mod only wants the things of some type near a
+// point. searchMobjs does the filtering in C over the same blockmap walk
+// and hands back an array of the things that passed:
+//
+//   searchMobjs(mobj, radius[, filter])     -- around mobj, leaving it out
+//   searchMobjs(x, y, z, radius[, filter])  -- around a point
+//
+// A thing passes if its center is within radius of the origin, on the
+// X/Y plane by default. Fields of the optional filter table:
+//
+//   type     - an MT_ constant, or an array of them
+//   flags    - MF_ flags that must all be set
+//   noflags  - MF_ flags that must all be clear
+//   dist3d   - also measure along Z, between vertical centers
+//   sight    - only things the origin mobj can see (mobj origin only)
+//   sort     - nearest first, instead of blockmap order
+//   limit    - keep at most this many
+//
+// The result only depends on the game state, so it is safe to use from
+// any hook, and in the same order on every client.
+//
+
+typedef struct
+{
+	mobj_t *mobj;
+	UINT64 dist; // squared
+	UINT32 order; // position in blockmap order, breaks ties when sorting
+} mobjsearchresult_t;
+
+static mobjsearchresult_t *searchresults = NULL;
+static size_t searchresults_capacity = 0;
+
+static UINT8 *searchtypes = NULL; // bit per mobj type, for filter.type arrays
+
+static int SearchResultCmp(const void *a, const void *b)
+{
+	const mobjsearchresult_t *ra = a, *rb = b;
+	if (ra->dist != rb->dist)
+		return ra->dist < rb->dist ? -1 : 1;
+	return (ra->order > rb->order) - (ra->order < rb->order);
+}
+
+static int lib_searchMobjs(lua_State *L)
+{
+	mobj_t *origin = NULL;
+	fixed_t x, y, z, radius;
+	INT32 xl, xh, yl, yh;
+	int filter;
+	mobjtype_t type = MT_NULL;
+	boolean typelist = false;
+	UINT32 flags = 0, noflags = 0;
+	boolean dist3d = false, sight = false, sort = false;
+	size_t limit = SIZE_MAX, count = 0, i;
+	UINT32 order = 0;
+	bthingit_t *it;
+	mobj_t *mo;
+
+	if (lua_isuserdata(L, 1))
+	{
+		origin = *((mobj_t **)luaL_checkudata(L, 1, META_MOBJ));
+		if (!origin)
+			return LUA_ErrInvalid(L, "mobj_t");
+		x = origin->x;
+		y = origin->y;
+		z = origin->z + origin->height/2;
+		radius = luaL_checkfixed(L, 2);
+		filter = 3;
+	}
+	else
+	{
+		x = luaL_checkfixed(L, 1);
+		y = luaL_checkfixed(L, 2);
+		z = luaL_checkfixed(L, 3);
+		radius = luaL_checkfixed(L, 4);
+		filter = 5;
+	}
+
+	if (radius < 0)
+		return luaL_error(L, "radius must not be negative");
+
+	if (!lua_isnoneornil(L, filter))
+	{
+		luaL_checktype(L, filter, LUA_TTABLE);
+
+		lua_getfield(L, filter, "type");
+		if (lua_istable(L, -1))
+		{
+			size_t n = lua_objlen(L, -1);
+
+			if (!searchtypes)
+				searchtypes = Z_Malloc((NUMMOBJTYPES + 7) / 8, PU_STATIC, NULL);
+			memset(searchtypes, 0, (NUMMOBJTYPES + 7) / 8);
+
+			for (i = 1; i <= n; i++)
+			{
+				lua_Integer t;
+				lua_rawgeti(L, -1, (int)i);
+				t = luaL_checkinteger(L, -1);
+				if (t < 0 || t >= NUMMOBJTYPES)
+					return luaL_error(L, "mobj type %d out of range (0 - %d)", (int)t, NUMMOBJTYPES-1);
+				searchtypes[t >> 3] |= 1 << (t & 7);
+				lua_pop(L, 1);
+			}
+			typelist = true;
+		}
+		else if (!lua_isnil(L, -1))
+		{
+			lua_Integer t = luaL_checkinteger(L, -1);
+			if (t <= MT_NULL || t >= NUMMOBJTYPES)
+				return luaL_error(L, "mobj type %d out of range (1 - %d)", (int)t, NUMMOBJTYPES-1);
+			type = (mobjtype_t)t;
+		}
+		lua_pop(L, 1);
+
+		lua_getfield(L, filter, "flags");
+		flags = (UINT32)luaL_optinteger(L, -1, 0);
+		lua_pop(L, 1);
+
+		lua_getfield(L, filter, "noflags");
+		noflags = (UINT32)luaL_optinteger(L, -1, 0);
+		lua_pop(L, 1);
+
+		lua_getfield(L, filter, "dist3d");
+		dist3d = lua_toboolean(L, -1);
+		lua_pop(L, 1);
+
+		lua_getfield(L, filter, "sight");
+		sight = lua_toboolean(L, -1);
+		lua_pop(L, 1);
+		if (sight && !origin)
+			return luaL_error(L, "sight filter needs an origin mobj");
+
+		lua_getfield(L, filter, "sort");
+		sort = lua_toboolean(L, -1);
+		lua_pop(L, 1);
+
+		lua_getfield(L, filter, "limit");
+		if (!lua_isnil(L, -1))
+		{
+			lua_Integer l = luaL_checkinteger(L, -1);
+			limit = l > 0 ? (size_t)l : 0;
+		}
+		lua_pop(L, 1);
+	}
+
+	xl = (unsigned)(x - radius - bmaporgx)>>MAPBLOCKSHIFT;
+	xh = (unsigned)(x + radius - bmaporgx)>>MAPBLOCKSHIFT;
+	yl = (unsigned)(y - radius - bmaporgy)>>MAPBLOCKSHIFT;
+	yh = (unsigned)(y + radius - bmaporgy)>>MAPBLOCKSHIFT;
+
+	BMBOUNDFIX(xl, xh, yl, yh);
+
+	it = limit ? P_NewBlockThingsIterator(xl, yl, xh, yh) : NULL;
+	if (it)
+	{
+		while ((mo = P_BlockThingsIteratorNext(it, false)) != NULL)
+		{
+			INT64 dx, dy, dz;
+			UINT64 dist;
+
+			if (mo == origin)
+				continue;
+
+			order++;
+
+			if (typelist ? !(searchtypes[mo->type >> 3] & (1 << (mo->type & 7)))
+				: (type != MT_NULL && mo->type != type))
+				continue;
+
+			if ((mo->flags & flags) != flags || (mo->flags & noflags))
+				continue;
+
+			// Rule out anything outside the box first,
+			// which also keeps the squares below from overflowing.
+			dx = (INT64)mo->x - x;
+			dy = (INT64)mo->y - y;
+			if (dx < -radius || dx > radius || dy < -radius || dy > radius)
+				continue;
+			dist = (UINT64)(dx*dx) + (UINT64)(dy*dy);
+
+			if (dist3d)
+			{
+				dz = (INT64)mo->z + mo->height/2 - z;
+				if (dz < -radius || dz > radius)
+					continue;
+				dist += (UINT64)(dz*dz);
+			}
+
+			if (dist > (UINT64)radius*(UINT64)radius)
+				continue;
+
+			if (sight && !P_CheckSight(origin, mo))
+				continue;
+
+			if (count == searchresults_capacity)
+			{
+				searchresults_capacity = searchresults_capacity ? searchresults_capacity * 2 : 64;
+				searchresults = Z_Realloc(searchresults, searchresults_capacity * sizeof (*searchresults), PU_STATIC, NULL);
+			}
+
+			searchresults[count].mobj = mo;
+			searchresults[count].dist = dist;
+			searchresults[count].order = order;
+			count++;
+
+			// Without sorting, the first ones found are the ones kept.
+			if (!sort && count == limit)
+				break;
+		}
+
+		P_FreeBlockThingsIterator(it);
+	}
+
+	if (sort && count > 1)
+		qsort(searchresults, count, sizeof (*searchresults), SearchResultCmp);
+
+	if (count > limit)
+		count = limit;
+
+	lua_createtable(L, (int)count, 0);
+	for (i = 0; i < count; i++)
+	{
+		LUA_PushUserdata(L, searchresults[i].mobj, META_MOBJ);
+		lua_rawseti(L, -2, (int)i + 1);
+	}
+
+	return 1;
+}
+
 int LUA_BlockmapLib(lua_State *L)
 {
 	lua_register(L, "searchBlockmap", lib_searchBlockmap);
+	lua_register(L, "searchMobjs", lib_searchMobjs);
 	return 0;
 }
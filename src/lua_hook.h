@@ -42,6 +42,7 @@ automatically.
 	X (MapThingSpawn),/* P_SpawnMapThing */\
 	X (FollowMobj),/* P_PlayerAfterThink Smiles mobj-following */\
 	X (HurtMsg),/* imhurttin */\
+	X (MobjThinkerBatch),/* P_RunThinkers, once per tic with every mobj of the type */\
 
 #define HOOK_LIST(X) \
 	X (NetVars),/* add to archive table (netsave) */\
@@ -129,6 +130,7 @@ int LUA_HookCharacterHUD
 );
 
 int  LUA_HookMobj(mobj_t *, int hook);
+boolean LUA_MobjHookAvailable(mobjtype_t type, int hook);
 int  LUA_Hook2Mobj(mobj_t *, mobj_t *, int hook);
 void LUA_HookInt(INT32 integer, int hook);
 void LUA_HookBool(boolean value, int hook);
@@ -136,6 +138,7 @@ int  LUA_HookPlayer(player_t *, int hook);
 int  LUA_HookTiccmd(player_t *, ticcmd_t *, int hook);
 int  LUA_HookKey(event_t *event, int hook); // Hooks for key events
 
+void LUA_HookMobjThinkerBatch(void);
 void LUA_HookPreThinkFrame(void);
 void LUA_HookThinkFrame(void);
 void LUA_HookPostThinkFrame(void);
@@ -13,6 +13,7 @@
 #include "doomdef.h"
 #include "doomstat.h"
 #include "p_mobj.h"
+#include "p_local.h" // thlist
 #include "g_game.h"
 #include "r_skins.h"
 #include "b_bot.h"
@@ -22,6 +23,7 @@
 #include "lua_libs.h"
 #include "lua_hook.h"
 #include "lua_hud.h" // hud_running errors
+#include "lua_profile.h"
 
 #include "m_perfstats.h"
 #include "netcode/d_netcmd.h" // for cv_perfstats
@@ -65,6 +67,10 @@ static int   nextid;
 // After a hook errors once, don't print the error again.
 static UINT8 * hooksErrored;
 
+// MobjThinkerBatch hooks added so far, so the thinker list is
+// only looked through when there are any.
+static int numBatchHooks;
+
 static int errorRef;
 
 static boolean mobj_hook_available(int hook_type, mobjtype_t mobj_type)
@@ -170,7 +176,20 @@ static void add_mobj_hook(lua_State *L, int hook_type)
 
 	luaL_argcheck(L, mobj_type < NUMMOBJTYPES, 3, "invalid mobjtype_t");
 
+	if (hook_type == MOBJ_HOOK(MobjThinkerBatch))
+	{
+		luaL_argcheck(L, mobj_type != MT_NULL, 3, "MobjThinkerBatch hooks need a mobjtype_t");
+		numBatchHooks++;
+	}
+
 	add_hook(&mobjHookIds[mobj_type][hook_type]);
+
+	// Mobjs with these hooks never sleep (see P_MobjCanSleep),
+	// so wake the ones that fell asleep before the hook existed.
+	if (hook_type == MOBJ_HOOK(MobjThinker)
+		|| hook_type == MOBJ_HOOK(MobjThinkerBatch)
+		|| hook_type == MOBJ_HOOK(MobjMoveCollide))
+		P_WakeAllMobjs();
 }
 
 static void add_hud_hook(lua_State *L, int idx)
@@ -267,6 +286,7 @@ struct Hook_State {
 	INT32        status;/* return status to calling function */
 	void       * userdata;
 	int          hook_type;
+	const char * const * names;/* names of this kind of hook, by hook_type */
 	mobjtype_t   mobj_type;/* >0 if mobj hook */
 	const char * string;/* used to fetch table, ran first if set */
 	int          top;/* index of last argument passed to hook */
@@ -309,6 +329,7 @@ static boolean init_hook_type
 		Hook_State * hook,
 		int          status,
 		int          hook_type,
+		const char * const * names,
 		mobjtype_t   mobj_type,
 		const char * string,
 		int          nonzero
@@ -319,6 +340,7 @@ static boolean init_hook_type
 	{
 		start_hook_stack();
 		hook->hook_type = hook_type;
+		hook->names = names;
 		hook->mobj_type = mobj_type;
 		hook->string = string;
 		return begin_hook_values(hook);
@@ -334,7 +356,7 @@ static boolean prepare_hook
 		int hook_type
 ){
 	return init_hook_type(hook, default_status,
-			hook_type, 0, NULL,
+			hook_type, hookNames, 0, NULL,
 			hookIds[hook_type].numHooks);
 }
 
@@ -353,7 +375,7 @@ static boolean prepare_mobj_hook
 		I_Error("MT_NULL has been passed to a mobj hook\n");
 #endif
 	return init_hook_type(hook, default_status,
-			hook_type, mobj_type, NULL,
+			hook_type, mobjHookNames, mobj_type, NULL,
 			mobj_hook_available(hook_type, mobj_type));
 }
 
@@ -365,7 +387,7 @@ static boolean prepare_string_hook
 		const char * string
 ){
 	if (init_hook_type(hook, default_status,
-				hook_type, 0, string,
+				hook_type, stringHookNames, 0, string,
 				stringHooks[hook_type].ref))
 	{
 		lua_pushstring(gL, string);
@@ -382,7 +404,7 @@ static boolean prepare_hud_hook
 		int hook_type
 ){
 	return init_hook_type(hook, default_status,
-			hook_type, 0, NULL,
+			hook_type, hudHookNames, 0, NULL,
 			hudHookIds[hook_type].numHooks);
 }
 
@@ -415,7 +437,19 @@ static void get_hook_from_table(Hook_State *hook, int n)
 
 static int call_single_hook_no_copy(Hook_State *hook)
 {
-	if (lua_pcall(gL, hook->values, hook->results, EINDEX) == 0)
+	const boolean profile = lua_profiling;
+	int err;
+
+	if (profile)
+		LUA_ProfileHookStart(gL, lua_gettop(gL) - hook->values,
+				hook->names[hook->hook_type], hook->string);
+
+	err = lua_pcall(gL, hook->values, hook->results, EINDEX);
+
+	if (profile)
+		LUA_ProfileHookEnd();
+
+	if (err == 0)
 	{
 		if (hook->results > 0)
 		{
@@ -525,9 +559,39 @@ static void call_hud_hooks
 		int        results,
 		Hook_Callback results_handler
 ){
+	const hook_t * map = &hudHookIds[hook->hook_type];
+
 	hud_running = true; // local hook
 	init_hook_call(hook, results, results_handler);
-	call_mapped(hook, &hudHookIds[hook->hook_type]);
+
+	if (cv_perfstats.value == 6)
+	{
+		// time every hook for perf stats, numbering them across all HUD hook types
+		int hook_index = 0;
+		int k;
+
+		for (k = 0; k < hook->hook_type; ++k)
+			hook_index += hudHookIds[k].numHooks;
+
+		for (k = 0; k < map->numHooks; ++k)
+		{
+			precise_t time_taken;
+			lua_Debug ar;
+
+			get_hook(hook, map->ids, k);
+			lua_pushvalue(gL, -1);/* need the function again */
+			time_taken = I_GetPreciseTime();
+
+			call_single_hook(hook);
+
+			time_taken = I_GetPreciseTime() - time_taken;
+			lua_getinfo(gL, ">S", &ar);
+			PS_SetHUDHookInfo(hook_index + k, time_taken, ar.short_src);
+		}
+	}
+	else
+		call_mapped(hook, map);
+
 	hud_running = false;
 
 	lua_pushnil(gL);
@@ -599,6 +663,12 @@ static void res_force(Hook_State *hook)
                                GENERALISED HOOKS
    ========================================================================= */
 
+// Whether any Lua function is hooked to this mobj type, without calling it.
+boolean LUA_MobjHookAvailable(mobjtype_t type, int hook_type)
+{
+	return gL != NULL && mobj_hook_available(hook_type, type);
+}
+
 int LUA_HookMobj(mobj_t *mobj, int hook_type)
 {
 	Hook_State hook;
@@ -778,6 +848,111 @@ static void hook_think_frame(int type)
 	}
 }
 
+/*
+MobjThinkerBatch hooks are called with an array of mobjs instead of a single
+one, so a script handling many objects of a type pays for one hook call per
+tic rather than one per object:
+
+	addHook("MobjThinkerBatch", function(mobjs)
+		for i = 1, #mobjs do
+			...
+		end
+	end, MT_MYOBJECT)
+
+The rules, all of which only depend on synced game state:
+
+ - The hooks run once per tic, right before the mobj thinkers, and after
+   PreThinkFrame and the players' P_PlayerThink.
+ - Types are gone through in order of their mobjtype_t number; several
+   hooks for the same type run in the order they were added.
+ - The array holds the mobjs of the type in thinker list order, which is
+   the order their MobjThinker hooks would be called in (without
+   cv_sortthinkers). Mobjs P_MobjThinker wouldn't run, such as those
+   with MF_NOTHINK or disabled bosses, are left out.
+ - Mobjs removed by an earlier hook in the same tic are left out. Mobjs
+   spawned by the hooks are not added; they think normally this tic.
+ - The return value is ignored. To stop the regular thinker from running
+   for a mobj, a MobjThinker hook is still needed.
+ - Like MobjThinker hooks, they keep mobjs of the type from going to sleep.
+*/
+
+static mobj_t ** batchMobjs;
+static size_t    numBatchMobjs;
+static size_t    maxBatchMobjs;
+
+void LUA_HookMobjThinkerBatch(void)
+{
+	Hook_State hook;
+	thinker_t *th;
+	mobj_t *mo;
+	mobjtype_t type;
+	size_t i, n;
+
+	if (!numBatchHooks)
+		return;
+
+	numBatchMobjs = 0;
+
+	for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
+	{
+		if (th->function != (actionf_p1)P_MobjThinker)
+			continue;
+
+		mo = (mobj_t *)th;
+
+		if (!mobjHookIds[mo->type][MOBJ_HOOK(MobjThinkerBatch)].numHooks)
+			continue;
+
+		/* same as what P_MobjThinker skips */
+		if ((mo->flags & MF_NOTHINK) || ((mo->flags & MF_BOSS) && mo->spawnpoint
+					&& (bossdisabled & (1<<mo->spawnpoint->args[0]))))
+			continue;
+
+		if (numBatchMobjs == maxBatchMobjs)
+		{
+			maxBatchMobjs = maxBatchMobjs ? maxBatchMobjs * 2 : 256;
+			Z_Realloc(batchMobjs, maxBatchMobjs * sizeof *batchMobjs,
+					PU_STATIC, &batchMobjs);
+		}
+
+		batchMobjs[numBatchMobjs++] = mo;
+	}
+
+	if (!numBatchMobjs)
+		return;
+
+	for (type = 0; type < NUMMOBJTYPES; ++type)
+	{
+		const hook_t * map = &mobjHookIds[type][MOBJ_HOOK(MobjThinkerBatch)];
+
+		if (!init_hook_type(&hook, 0, MOBJ_HOOK(MobjThinkerBatch),
+					mobjHookNames, type, NULL, map->numHooks))
+			continue;
+
+		lua_newtable(gL);
+
+		/* removed mobjs are only freed by the thinker loop, so this is safe */
+		for (i = 0, n = 0; i < numBatchMobjs; ++i)
+		{
+			mo = batchMobjs[i];
+
+			if (mo->type == type && !P_MobjWasRemoved(mo))
+			{
+				LUA_PushUserdata(gL, mo, META_MOBJ);
+				lua_rawseti(gL, -2, ++n);
+			}
+		}
+
+		if (n > 0)
+		{
+			init_hook_call(&hook, 0, res_none);
+			ps_lua_mobjhooks.value.i += call_mapped(&hook, map);
+		}
+
+		lua_settop(gL, 0);
+	}
+}
+
 void LUA_HookPreThinkFrame(void)
 {
 	hook_think_frame(HOOK(PreThinkFrame));
@@ -1015,6 +1190,10 @@ void LUA_HookNetArchive(lua_CFunction archFunc)
 		lua_insert(gL, EINDEX);
 
 		begin_hook_values(&hook);
+		hook.hook_type = HOOK(NetVars);
+		hook.names = hookNames;
+		hook.mobj_type = 0;
+		hook.string = NULL;
 
 		// tables becomes an upvalue of archFunc
 		lua_pushvalue(gL, -1);
@@ -1262,6 +1262,63 @@ static int libd_fadeScreen(lua_State *L)
 	return 0;
 }
 
+static int lib_draw_ref;
+
+// v.record(drawlist, function(v) ... end)
+// Clears drawlist, then calls the function with everything it draws going
+// into drawlist instead of onto the screen.
+static int libd_record(lua_State *L)
+{
+	huddrawlist_h record = *((huddrawlist_h *)luaL_checkudata(L, 1, META_HUDDRAWLIST));
+	int err;
+
+	HUDONLY
+	luaL_checktype(L, 2, LUA_TFUNCTION);
+	lua_settop(L, 2);
+
+	LUA_HUD_ClearDrawList(record);
+
+	// Remember where things were drawn to before
+	lua_getfield(L, LUA_REGISTRYINDEX, "HUD_DRAW_LIST");
+
+	lua_pushlightuserdata(L, record);
+	lua_setfield(L, LUA_REGISTRYINDEX, "HUD_DRAW_LIST");
+
+	lua_pushvalue(L, 2);
+	lua_getref(L, lib_draw_ref);
+	err = lua_pcall(L, 1, 0, 0);
+
+	lua_pushvalue(L, 3);
+	lua_setfield(L, LUA_REGISTRYINDEX, "HUD_DRAW_LIST");
+
+	if (err)
+		return lua_error(L);
+	return 0;
+}
+
+// v.drawList(drawlist)
+// Draws everything recorded into drawlist.
+static int libd_drawList(lua_State *L)
+{
+	huddrawlist_h record = *((huddrawlist_h *)luaL_checkudata(L, 1, META_HUDDRAWLIST));
+	huddrawlist_h list;
+
+	HUDONLY
+
+	lua_getfield(L, LUA_REGISTRYINDEX, "HUD_DRAW_LIST");
+	list = (huddrawlist_h) lua_touserdata(L, -1);
+	lua_pop(L, 1);
+
+	if (list == record)
+		return luaL_error(L, "can't draw a draw list while recording into it");
+
+	if (LUA_HUD_IsDrawListValid(list))
+		LUA_HUD_AppendDrawList(list, record);
+	else
+		LUA_HUD_DrawList(record);
+	return 0;
+}
+
 static int libd_width(lua_State *L)
 {
 	HUDONLY
@@ -1386,6 +1443,8 @@ static luaL_Reg lib_draw[] = {
 	{"drawScaledNameTag", libd_drawScaledNameTag},
 	{"drawLevelTitle", libd_drawLevelTitle},
 	{"fadeScreen", libd_fadeScreen},
+	{"record", libd_record},
+	{"drawList", libd_drawList},
 	// misc
 	{"stringWidth", libd_stringWidth},
 	{"nameTagWidth", libd_nameTagWidth},
@@ -1409,8 +1468,6 @@ static luaL_Reg lib_draw[] = {
 	{NULL, NULL}
 };
 
-static int lib_draw_ref;
-
 //
 // lib_hud
 //
@@ -1447,11 +1504,60 @@ static int lib_hudenabled(lua_State *L)
 // add a HUD element for rendering
 extern int lib_hudadd(lua_State *L);
 
+//
+// Retained draw lists
+//
+// HUD hooks that draw the same thing most tics can record their drawing
+// into a draw list once, with v.record, and then just draw the list with
+// v.drawList until what they draw changes.
+//
+
+// hud.newDrawList()
+static int lib_hudnewdrawlist(lua_State *L)
+{
+	huddrawlist_h *record = lua_newuserdata(L, sizeof (*record));
+	*record = LUA_HUD_CreateDrawList();
+	luaL_getmetatable(L, META_HUDDRAWLIST);
+	lua_setmetatable(L, -2);
+	return 1;
+}
+
+static int drawlist_clear(lua_State *L)
+{
+	huddrawlist_h record = *((huddrawlist_h *)luaL_checkudata(L, 1, META_HUDDRAWLIST));
+	lua_getfield(L, LUA_REGISTRYINDEX, "HUD_DRAW_LIST");
+	if (lua_touserdata(L, -1) == record)
+		return luaL_error(L, "can't clear a draw list while recording into it");
+	LUA_HUD_ClearDrawList(record);
+	return 0;
+}
+
+static int drawlist_len(lua_State *L)
+{
+	huddrawlist_h record = *((huddrawlist_h *)luaL_checkudata(L, 1, META_HUDDRAWLIST));
+	lua_pushinteger(L, LUA_HUD_DrawListLength(record));
+	return 1;
+}
+
+static int drawlist_gc(lua_State *L)
+{
+	huddrawlist_h *record = luaL_checkudata(L, 1, META_HUDDRAWLIST);
+	LUA_HUD_DestroyDrawList(*record);
+	*record = NULL;
+	return 0;
+}
+
+static luaL_Reg drawlist_methods[] = {
+	{"clear", drawlist_clear},
+	{NULL, NULL}
+};
+
 static luaL_Reg lib_hud[] = {
 	{"enable", lib_hudenable},
 	{"disable", lib_huddisable},
 	{"enabled", lib_hudenabled},
 	{"add", lib_hudadd},
+	{"newDrawList", lib_hudnewdrawlist},
 	{NULL, NULL}
 };
 
@@ -1472,6 +1578,14 @@ int LUA_HudLib(lua_State *L)
 	LUA_RegisterUserdataMetatable(L, META_PATCH, patch_get, patch_set, NULL);
 	LUA_RegisterUserdataMetatable(L, META_CAMERA, camera_get, camera_set, NULL);
 
+	luaL_newmetatable(L, META_HUDDRAWLIST);
+		LUA_SetCFunctionField(L, "__gc", drawlist_gc);
+		LUA_SetCFunctionField(L, "__len", drawlist_len);
+		lua_newtable(L);
+		luaL_register(L, NULL, drawlist_methods);
+		lua_setfield(L, -2, "__index");
+	lua_pop(L, 1);
+
 	patch_fields_ref = Lua_CreateFieldTable(L, patch_opt);
 	camera_fields_ref = Lua_CreateFieldTable(L, camera_opt);
 
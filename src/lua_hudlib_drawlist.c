@@ -16,6 +16,13 @@
 
 #include "v_video.h"
 #include "z_zone.h"
+#include "command.h"
+#include "i_video.h" // rendermode
+#include "m_bbox.h"
+
+// Draws patches that share a texture one after another in OpenGL,
+// where that can't change what ends up on screen.
+consvar_t cv_luahudbatching = CVAR_INIT ("luahudbatching", "On", CV_SAVE, CV_OnOff, NULL);
 
 enum drawitem_e {
 	DI_Draw = 0,
@@ -69,8 +76,17 @@ struct huddrawlist_s {
 	char *strbuf;
 	size_t strbuf_capacity;
 	size_t strbuf_len;
+	size_t *order; // items in the order to draw them in, for OpenGL
+	size_t order_capacity;
+	boolean order_valid;
+	UINT32 level; // drawlistlevel when the list was last cleared
 };
 
+// Bumped whenever a level is loaded. Items point at patches and colormaps
+// that loading a level can free, so lists recorded before that are
+// emptied the next time they are used.
+static UINT32 drawlistlevel = 0;
+
 // alignment types for v.drawString
 enum align {
 	align_left = 0,
@@ -110,6 +126,9 @@ huddrawlist_h LUA_HUD_CreateDrawList(void)
 	drawlist->strbuf = NULL;
 	drawlist->strbuf_capacity = 0;
 	drawlist->strbuf_len = 0;
+	drawlist->order = NULL;
+	drawlist->order_capacity = 0;
+	drawlist->order_valid = false;
 
 	return drawlist;
 }
@@ -132,6 +151,20 @@ void LUA_HUD_ClearDrawList(huddrawlist_h list)
 		list->strbuf[0] = 0;
 	}
 	list->strbuf_len = 0;
+	list->order_valid = false;
+	list->level = drawlistlevel;
+}
+
+// Empties a list recorded before the last level load.
+static void CheckDrawListLevel(huddrawlist_h list)
+{
+	if (list->level != drawlistlevel)
+		LUA_HUD_ClearDrawList(list);
+}
+
+void LUA_HUD_FlushDrawLists(void)
+{
+	drawlistlevel++;
 }
 
 void LUA_HUD_DestroyDrawList(huddrawlist_h list)
@@ -142,6 +175,14 @@ void LUA_HUD_DestroyDrawList(huddrawlist_h list)
 	{
 		Z_Free(list->items);
 	}
+	if (list->strbuf)
+	{
+		Z_Free(list->strbuf);
+	}
+	if (list->order)
+	{
+		Z_Free(list->order);
+	}
 	Z_Free(list);
 }
 
@@ -156,6 +197,7 @@ boolean LUA_HUD_IsDrawListValid(huddrawlist_h list)
 static size_t AllocateDrawItem(huddrawlist_h list)
 {
 	if (!list) I_Error("can't allocate draw item: invalid list");
+	CheckDrawListLevel(list);
 	if (list->items_capacity <= list->items_len + 1)
 	{
 		if (list->items_capacity == 0) list->items_capacity = 128;
@@ -163,6 +205,7 @@ static size_t AllocateDrawItem(huddrawlist_h list)
 		list->items = (drawitem_t *) Z_Realloc(list->items, sizeof(struct drawitem_s) * list->items_capacity, PU_STATIC, NULL);
 	}
 
+	list->order_valid = false;
 	return list->items_len++;
 }
 
@@ -447,136 +490,334 @@ void LUA_HUD_AddFadeScreen(
 	item->strength = strength;
 }
 
-void LUA_HUD_DrawList(huddrawlist_h list)
+void LUA_HUD_AppendDrawList(huddrawlist_h list, huddrawlist_h src)
 {
 	size_t i;
 
-	if (!list) I_Error("HUD drawlist invalid");
-	if (list->items_len <= 0) return;
-	if (!list->items) I_Error("HUD drawlist->items invalid");
+	if (!src) I_Error("can't append draw list: invalid list");
+	CheckDrawListLevel(src);
 
-	for (i = 0; i < list->items_len; i++)
+	for (i = 0; i < src->items_len; i++)
 	{
-		drawitem_t *item = &list->items[i];
+		size_t j = AllocateDrawItem(list);
+		list->items[j] = src->items[i];
 
-		switch (item->type)
+		switch (src->items[i].type)
 		{
-			case DI_Draw:
-				V_DrawFixedPatch(item->x<<FRACBITS, item->y<<FRACBITS, FRACUNIT, item->flags, item->patch, item->colormap);
+			case DI_DrawString:
+			case DI_DrawNameTag:
+			case DI_DrawScaledNameTag:
+			case DI_DrawLevelTitle:
+			{
+				// CopyString can move the items around
+				const char *str = CopyString(list, src->items[i].str);
+				list->items[j].str = str;
 				break;
-			case DI_DrawScaled:
-				V_DrawFixedPatch(item->x, item->y, item->scale, item->flags, item->patch, item->colormap);
+			}
+			default:
 				break;
-			case DI_DrawStretched:
-				V_DrawStretchyFixedPatch(item->x, item->y, item->hscale, item->vscale, item->flags, item->patch, item->colormap);
+		}
+	}
+}
+
+size_t LUA_HUD_DrawListLength(huddrawlist_h list)
+{
+	CheckDrawListLevel(list);
+	return list->items_len;
+}
+
+#ifdef HWRENDER
+//
+// Draw order for OpenGL
+//
+// Drawing patches that share a texture, colormap and flags one after
+// another saves rebinding textures and switching blend state in between.
+// A patch is only moved ahead of the ones it skips over if none of them
+// overlap it; everything is compared in the same 320x200 space, so that
+// only goes for patches whose flags place them on the screen the same way.
+// Anything else, like strings, fills and cropped patches, is never skipped
+// over. The order is worked out once per list, as lists get drawn again
+// every frame until the next tic.
+//
+
+#define BATCH_LOOKAHEAD 32 // how far ahead to look for patches to draw next
+
+#define BATCH_POSITIONFLAGS (V_SCALEPATCHMASK|V_SNAPTOTOP|V_SNAPTOBOTTOM|V_SNAPTOLEFT|V_SNAPTORIGHT|V_NOSCALESTART|V_PERPLAYER)
+
+static boolean IsBatchable(const drawitem_t *item)
+{
+	switch (item->type)
+	{
+		case DI_Draw:
+		case DI_DrawScaled:
+		case DI_DrawStretched:
+			// Positions aren't in 320x200 space with V_NOSCALESTART
+			return !(item->flags & V_NOSCALESTART);
+		default:
+			return false;
+	}
+}
+
+// Finds a box the patch surely fits in. Offsets and flipping are accounted
+// for by making it extend as far as the patch could to either side.
+static void GetItemBox(const drawitem_t *item, INT64 *box)
+{
+	const patch_t *patch = item->patch;
+	INT64 x = item->x, y = item->y;
+	INT64 hscale, vscale, rx, ry;
+
+	switch (item->type)
+	{
+		case DI_Draw:
+			x = (INT64)item->x << FRACBITS;
+			y = (INT64)item->y << FRACBITS;
+			hscale = vscale = FRACUNIT;
+			break;
+		case DI_DrawScaled:
+			hscale = vscale = item->scale;
+			break;
+		default: // DI_DrawStretched
+			hscale = item->hscale;
+			vscale = item->vscale;
+			break;
+	}
+
+	if (hscale < 0)
+		hscale = -hscale;
+	if (vscale < 0)
+		vscale = -vscale;
+
+	rx = max(abs(patch->leftoffset), abs(patch->width - patch->leftoffset)) * hscale;
+	ry = max(abs(patch->topoffset), abs(patch->height - patch->topoffset)) * vscale;
+
+	// A pixel more on every side for rounding
+	box[BOXLEFT] = x - rx - FRACUNIT;
+	box[BOXRIGHT] = x + rx + FRACUNIT;
+	box[BOXTOP] = y - ry - FRACUNIT;
+	box[BOXBOTTOM] = y + ry + FRACUNIT;
+}
+
+static boolean BoxesOverlap(const INT64 *a, const INT64 *b)
+{
+	return a[BOXLEFT] < b[BOXRIGHT] && b[BOXLEFT] < a[BOXRIGHT]
+		&& a[BOXTOP] < b[BOXBOTTOM] && b[BOXTOP] < a[BOXBOTTOM];
+}
+
+static boolean SameBatch(const drawitem_t *a, const drawitem_t *b)
+{
+	return a->patch == b->patch && a->colormap == b->colormap && a->flags == b->flags;
+}
+
+static void SortDrawList(huddrawlist_h list)
+{
+	const size_t n = list->items_len;
+	INT64 (*boxes)[4];
+	boolean *drawn;
+	size_t i, j, k, count = 0;
+
+	if (list->order_capacity < n)
+	{
+		list->order_capacity = list->items_capacity;
+		list->order = Z_Realloc(list->order, sizeof (*list->order) * list->order_capacity, PU_STATIC, NULL);
+	}
+
+	boxes = Z_Malloc(sizeof (*boxes) * n, PU_STATIC, NULL);
+	drawn = Z_Calloc(sizeof (*drawn) * n, PU_STATIC, NULL);
+
+	for (i = 0; i < n; i++)
+		if (IsBatchable(&list->items[i]))
+			GetItemBox(&list->items[i], boxes[i]);
+
+	for (i = 0; i < n; i++)
+	{
+		const drawitem_t *item = &list->items[i];
+
+		if (drawn[i])
+			continue;
+
+		list->order[count++] = i;
+		drawn[i] = true;
+
+		if (!IsBatchable(item))
+			continue;
+
+		// Pull the following patches in the same batch up behind this one
+		for (j = i + 1; j < n && j <= i + BATCH_LOOKAHEAD; j++)
+		{
+			const drawitem_t *next = &list->items[j];
+			boolean blocked = false;
+
+			if (drawn[j])
+				continue;
+
+			if (!IsBatchable(next) || (next->flags & BATCH_POSITIONFLAGS) != (item->flags & BATCH_POSITIONFLAGS))
+				break; // can't tell what this overlaps, so nothing after it can be moved past it
+
+			if (!SameBatch(item, next))
+				continue;
+
+			for (k = i + 1; k < j && !blocked; k++)
+				if (!drawn[k] && BoxesOverlap(boxes[k], boxes[j]))
+					blocked = true;
+
+			if (!blocked)
+			{
+				list->order[count++] = j;
+				drawn[j] = true;
+			}
+		}
+	}
+
+	Z_Free(boxes);
+	Z_Free(drawn);
+
+	list->order_valid = true;
+}
+#endif
+
+static void DrawItem(drawitem_t *item)
+{
+	switch (item->type)
+	{
+		case DI_Draw:
+			V_DrawFixedPatch(item->x<<FRACBITS, item->y<<FRACBITS, FRACUNIT, item->flags, item->patch, item->colormap);
+			break;
+		case DI_DrawScaled:
+			V_DrawFixedPatch(item->x, item->y, item->scale, item->flags, item->patch, item->colormap);
+			break;
+		case DI_DrawStretched:
+			V_DrawStretchyFixedPatch(item->x, item->y, item->hscale, item->vscale, item->flags, item->patch, item->colormap);
+			break;
+		case DI_DrawCropped:
+			V_DrawCroppedPatch(item->x, item->y, item->hscale, item->vscale, item->flags, item->patch, item->colormap, item->sx, item->sy, item->w, item->h);
+			break;
+		case DI_DrawNum:
+			V_DrawTallNum(item->x, item->y, item->flags, item->num);
+			break;
+		case DI_DrawPaddedNum:
+			V_DrawPaddedTallNum(item->x, item->y, item->flags, item->num, item->digits);
+			break;
+		case DI_DrawFill:
+			V_DrawFill(item->x, item->y, item->w, item->h, item->c);
+			break;
+		case DI_DrawString:
+			switch(item->align)
+			{
+			// hu_font
+			case align_left:
+				V_DrawString(item->x, item->y, item->flags, item->str);
 				break;
-			case DI_DrawCropped:
-				V_DrawCroppedPatch(item->x, item->y, item->hscale, item->vscale, item->flags, item->patch, item->colormap, item->sx, item->sy, item->w, item->h);
+			case align_center:
+				V_DrawCenteredString(item->x, item->y, item->flags, item->str);
 				break;
-			case DI_DrawNum:
-				V_DrawTallNum(item->x, item->y, item->flags, item->num);
+			case align_right:
+				V_DrawRightAlignedString(item->x, item->y, item->flags, item->str);
 				break;
-			case DI_DrawPaddedNum:
-				V_DrawPaddedTallNum(item->x, item->y, item->flags, item->num, item->digits);
+			case align_fixed:
+				V_DrawStringAtFixed(item->x, item->y, item->flags, item->str);
 				break;
-			case DI_DrawFill:
-				V_DrawFill(item->x, item->y, item->w, item->h, item->c);
+			case align_fixedcenter:
+				V_DrawCenteredStringAtFixed(item->x, item->y, item->flags, item->str);
 				break;
-			case DI_DrawString:
-				switch(item->align)
-				{
-				// hu_font
-				case align_left:
-					V_DrawString(item->x, item->y, item->flags, item->str);
-					break;
-				case align_center:
-					V_DrawCenteredString(item->x, item->y, item->flags, item->str);
-					break;
-				case align_right:
-					V_DrawRightAlignedString(item->x, item->y, item->flags, item->str);
-					break;
-				case align_fixed:
-					V_DrawStringAtFixed(item->x, item->y, item->flags, item->str);
-					break;
-				case align_fixedcenter:
-					V_DrawCenteredStringAtFixed(item->x, item->y, item->flags, item->str);
-					break;
-				case align_fixedright:
-					V_DrawRightAlignedStringAtFixed(item->x, item->y, item->flags, item->str);
-					break;
-				// hu_font, 0.5x scale
-				case align_small:
-					V_DrawSmallString(item->x, item->y, item->flags, item->str);
-					break;
-				case align_smallfixed:
-					V_DrawSmallStringAtFixed(item->x, item->y, item->flags, item->str);
-					break;
-				case align_smallfixedcenter:
-					V_DrawCenteredSmallStringAtFixed(item->x, item->y, item->flags, item->str);
-					break;
-				case align_smallfixedright:
-					V_DrawRightAlignedSmallStringAtFixed(item->x, item->y, item->flags, item->str);
-					break;
-				case align_smallcenter:
-					V_DrawCenteredSmallString(item->x, item->y, item->flags, item->str);
-					break;
-				case align_smallright:
-					V_DrawRightAlignedSmallString(item->x, item->y, item->flags, item->str);
-					break;
-				case align_smallthin:
-					V_DrawSmallThinString(item->x, item->y, item->flags, item->str);
-					break;
-				case align_smallthincenter:
-					V_DrawCenteredSmallThinString(item->x, item->y, item->flags, item->str);
-					break;
-				case align_smallthinright:
-					V_DrawRightAlignedSmallThinString(item->x, item->y, item->flags, item->str);
-					break;
-				case align_smallthinfixed:
-					V_DrawSmallThinStringAtFixed(item->x, item->y, item->flags, item->str);
-					break;
-				case align_smallthinfixedcenter:
-					V_DrawCenteredSmallThinStringAtFixed(item->x, item->y, item->flags, item->str);
-					break;
-				case align_smallthinfixedright:
-					V_DrawRightAlignedSmallThinStringAtFixed(item->x, item->y, item->flags, item->str);
-					break;
-				// tny_font
-				case align_thin:
-					V_DrawThinString(item->x, item->y, item->flags, item->str);
-					break;
-				case align_thincenter:
-					V_DrawCenteredThinString(item->x, item->y, item->flags, item->str);
-					break;
-				case align_thinright:
-					V_DrawRightAlignedThinString(item->x, item->y, item->flags, item->str);
-					break;
-				case align_thinfixed:
-					V_DrawThinStringAtFixed(item->x, item->y, item->flags, item->str);
-					break;
-				case align_thinfixedcenter:
-					V_DrawCenteredThinStringAtFixed(item->x, item->y, item->flags, item->str);
-					break;
-				case align_thinfixedright:
-					V_DrawRightAlignedThinStringAtFixed(item->x, item->y, item->flags, item->str);
-					break;
-				}
+			case align_fixedright:
+				V_DrawRightAlignedStringAtFixed(item->x, item->y, item->flags, item->str);
 				break;
-			case DI_DrawNameTag:
-				V_DrawNameTag(item->x, item->y, item->flags, FRACUNIT, item->basecolormap, item->outlinecolormap, item->str);
+			// hu_font, 0.5x scale
+			case align_small:
+				V_DrawSmallString(item->x, item->y, item->flags, item->str);
 				break;
-			case DI_DrawScaledNameTag:
-				V_DrawNameTag(FixedInt(item->x), FixedInt(item->y), item->flags, item->scale, item->basecolormap, item->outlinecolormap, item->str);
+			case align_smallfixed:
+				V_DrawSmallStringAtFixed(item->x, item->y, item->flags, item->str);
 				break;
-			case DI_DrawLevelTitle:
-				V_DrawLevelTitle(item->x, item->y, item->flags, item->str);
+			case align_smallfixedcenter:
+				V_DrawCenteredSmallStringAtFixed(item->x, item->y, item->flags, item->str);
 				break;
-			case DI_FadeScreen:
-				V_DrawFadeScreen(item->color, item->strength);
+			case align_smallfixedright:
+				V_DrawRightAlignedSmallStringAtFixed(item->x, item->y, item->flags, item->str);
 				break;
-			default:
-				I_Error("can't draw draw list item: invalid draw list item type");
-				continue;
-		}
+			case align_smallcenter:
+				V_DrawCenteredSmallString(item->x, item->y, item->flags, item->str);
+				break;
+			case align_smallright:
+				V_DrawRightAlignedSmallString(item->x, item->y, item->flags, item->str);
+				break;
+			case align_smallthin:
+				V_DrawSmallThinString(item->x, item->y, item->flags, item->str);
+				break;
+			case align_smallthincenter:
+				V_DrawCenteredSmallThinString(item->x, item->y, item->flags, item->str);
+				break;
+			case align_smallthinright:
+				V_DrawRightAlignedSmallThinString(item->x, item->y, item->flags, item->str);
+				break;
+			case align_smallthinfixed:
+				V_DrawSmallThinStringAtFixed(item->x, item->y, item->flags, item->str);
+				break;
+			case align_smallthinfixedcenter:
+				V_DrawCenteredSmallThinStringAtFixed(item->x, item->y, item->flags, item->str);
+				break;
+			case align_smallthinfixedright:
+				V_DrawRightAlignedSmallThinStringAtFixed(item->x, item->y, item->flags, item->str);
+				break;
+			// tny_font
+			case align_thin:
+				V_DrawThinString(item->x, item->y, item->flags, item->str);
+				break;
+			case align_thincenter:
+				V_DrawCenteredThinString(item->x, item->y, item->flags, item->str);
+				break;
+			case align_thinright:
+				V_DrawRightAlignedThinString(item->x, item->y, item->flags, item->str);
+				break;
+			case align_thinfixed:
+				V_DrawThinStringAtFixed(item->x, item->y, item->flags, item->str);
+				break;
+			case align_thinfixedcenter:
+				V_DrawCenteredThinStringAtFixed(item->x, item->y, item->flags, item->str);
+				break;
+			case align_thinfixedright:
+				V_DrawRightAlignedThinStringAtFixed(item->x, item->y, item->flags, item->str);
+				break;
+			}
+			break;
+		case DI_DrawNameTag:
+			V_DrawNameTag(item->x, item->y, item->flags, FRACUNIT, item->basecolormap, item->outlinecolormap, item->str);
+			break;
+		case DI_DrawScaledNameTag:
+			V_DrawNameTag(FixedInt(item->x), FixedInt(item->y), item->flags, item->scale, item->basecolormap, item->outlinecolormap, item->str);
+			break;
+		case DI_DrawLevelTitle:
+			V_DrawLevelTitle(item->x, item->y, item->flags, item->str);
+			break;
+		case DI_FadeScreen:
+			V_DrawFadeScreen(item->color, item->strength);
+			break;
+		default:
+			I_Error("can't draw draw list item: invalid draw list item type");
+	}
+}
+
+void LUA_HUD_DrawList(huddrawlist_h list)
+{
+	size_t i;
+
+	if (!list) I_Error("HUD drawlist invalid");
+	CheckDrawListLevel(list);
+	if (list->items_len <= 0) return;
+	if (!list->items) I_Error("HUD drawlist->items invalid");
+
+#ifdef HWRENDER
+	if (rendermode == render_opengl && cv_luahudbatching.value)
+	{
+		if (!list->order_valid)
+			SortDrawList(list);
+
+		for (i = 0; i < list->items_len; i++)
+			DrawItem(&list->items[list->order[i]]);
+		return;
 	}
+#endif
+
+	for (i = 0; i < list->items_len; i++)
+		DrawItem(&list->items[i]);
 }
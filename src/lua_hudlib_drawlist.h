@@ -142,9 +142,17 @@ void LUA_HUD_AddFadeScreen(
 	UINT8 strength
 );
 
+// Adds copies of all the items in src to the end of list.
+void LUA_HUD_AppendDrawList(huddrawlist_h list, huddrawlist_h src);
+size_t LUA_HUD_DrawListLength(huddrawlist_h list);
+
 // Draws the given draw list
 void LUA_HUD_DrawList(huddrawlist_h list);
 
+// Empties every draw list before it is next used, as loading a level
+// frees the patches and colormaps they point at.
+void LUA_HUD_FlushDrawLists(void);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
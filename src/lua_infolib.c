@@ -30,6 +30,7 @@
 #include "lua_libs.h"
 #include "lua_hud.h" // hud_running errors
 #include "lua_hook.h" // hook_cmd_running errors
+#include "lua_profile.h"
 
 boolean LUA_CallAction(enum actionnum actionnum, mobj_t *actor);
 state_t *astate;
@@ -870,7 +871,14 @@ boolean LUA_CallAction(enum actionnum actionnum, mobj_t *actor)
 	luaactions[luaactionstack] = actionpointers[actionnum].name;
 	++luaactionstack;
 
-	LUA_Call(gL, 3, 0, -(2 + 3));
+	if (lua_profiling)
+	{
+		LUA_ProfileHookStart(gL, -4, "Action", actionpointers[actionnum].name);
+		LUA_Call(gL, 3, 0, -(2 + 3));
+		LUA_ProfileHookEnd();
+	}
+	else
+		LUA_Call(gL, 3, 0, -(2 + 3));
 	lua_pop(gL, -1); // Error handler
 
 	if (superstack[actionnum])
@@ -22,6 +22,7 @@ extern boolean ignoregameinputs;
 #define LREG_STATEACTION "STATE_ACTION"
 #define LREG_ACTIONS "MOBJ_ACTION"
 #define LREG_METATABLES "METATABLES"
+#define LREG_TASKS "LUA_TASKS"
 
 #define META_STATE "STATE_T*"
 #define META_MOBJINFO "MOBJINFO_T*"
@@ -88,6 +89,7 @@ extern boolean ignoregameinputs;
 #define META_COLORMAP "COLORMAP"
 #define META_EXTRACOLORMAP "EXTRACOLORMAP_T*"
 #define META_CAMERA "CAMERA_T*"
+#define META_HUDDRAWLIST "HUDDRAWLIST"
 
 #define META_ACTION "ACTIONF_T*"
 
@@ -113,6 +115,7 @@ int LUA_MapLib(lua_State *L);
 int LUA_TagLib(lua_State *L);
 int LUA_PolyObjLib(lua_State *L);
 int LUA_BlockmapLib(lua_State *L);
+int LUA_TaskLib(lua_State *L);
 int LUA_HudLib(lua_State *L);
 int LUA_ColorLib(lua_State *L);
 int LUA_InputLib(lua_State *L);
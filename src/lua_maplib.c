@@ -852,6 +852,9 @@ static int sector_set(lua_State *L)
 	if (hook_cmd_running)
 		return luaL_error(L, "Do not alter sector_t in CMD building code!");
 
+	P_InvalidateSightCache();
+	P_InvalidateFOFHeights();
+
 	switch(field)
 	{
 	case sector_valid: // valid
@@ -953,6 +956,7 @@ static int sector_set(lua_State *L)
 		break;
 	case sector_special:
 		sector->special = (INT16)luaL_checkinteger(L, 3);
+		P_WakeAllMobjs();
 		break;
 	case sector_tag:
 		Tag_SectorFSet((UINT32)(sector - sectors), (INT16)luaL_checkinteger(L, 3));
@@ -962,12 +966,15 @@ static int sector_set(lua_State *L)
 	case sector_flags:
 		sector->flags = luaL_checkinteger(L, 3);
 		CheckForReverseGravity |= (sector->flags & MSF_GRAVITYFLIP);
+		P_WakeAllMobjs();
 		break;
 	case sector_specialflags:
 		sector->specialflags = luaL_checkinteger(L, 3);
+		P_WakeAllMobjs();
 		break;
 	case sector_damagetype:
 		sector->damagetype = (UINT8)luaL_checkinteger(L, 3);
+		P_WakeAllMobjs();
 		break;
 	case sector_triggertag:
 		sector->triggertag = (INT16)luaL_checkinteger(L, 3);
@@ -977,6 +984,7 @@ static int sector_set(lua_State *L)
 		break;
 	case sector_gravity:
 		sector->gravity = luaL_checkfixed(L, 3);
+		P_WakeAllMobjs();
 		break;
 	}
 	return 0;
@@ -2465,6 +2473,10 @@ static int ffloor_set(lua_State *L)
 	if (hook_cmd_running)
 		return luaL_error(L, "Do not alter ffloor_t in CMD building code!");
 
+	P_InvalidateSightCache();
+	P_InvalidateFOFHeights();
+	P_WakeAllMobjs();
+
 	switch(field)
 	{
 	case ffloor_valid: // valid
@@ -2629,6 +2641,9 @@ static int slope_set(lua_State *L)
 	if (hook_cmd_running)
 		return luaL_error(L, "Do not alter pslope_t in CMD building code!");
 
+	P_InvalidateSightCache();
+	P_WakeAllMobjs();
+
 	switch(field) // todo: reorganize this shit
 	{
 	case slope_valid: // valid
@@ -343,6 +343,8 @@ static int polyobj_set(lua_State *L)
 	if (hud_running)
 		return luaL_error(L, "Do not alter polyobj_t in HUD rendering code!");
 
+	P_InvalidateSightCache();
+
 	switch (field)
 	{
 	default:
@@ -0,0 +1,590 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 2024 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  lua_profile.c
+/// \brief Sampling profiler for Lua hooks
+
+#include "doomdef.h"
+#include "command.h"
+#include "console.h"
+#include "d_main.h" // srb2home
+#include "i_system.h" // I_GetPreciseTime
+#include "z_zone.h"
+
+#include "lua_script.h"
+#include "lua_libs.h"
+#include "lua_profile.h"
+
+#define PROFILE_DEFAULTINTERVAL 1000 // Lua instructions between samples
+#define PROFILE_MAXDEPTH 64 // stack frames kept per sample
+#define PROFILE_MAXHOOKS 16 // nested hook calls kept track of
+#define PROFILE_DEFAULTREPORT 20 // entries printed by "luaprofile report"
+
+boolean lua_profiling = false;
+UINT32 lua_profileallocs = 0;
+size_t lua_profileallocbytes = 0;
+
+// One thing the profiler keeps totals for. Which fields are used depends on
+// the table the entry is in.
+typedef struct
+{
+	void *key;
+	size_t keylen;
+	UINT32 hash;
+	char *label; // functions only
+	boolean named; // functions only; false if the label lacks a function name
+	precise_t self; // time spent in this function, line or stack itself
+	precise_t total; // functions only; time spent with it anywhere on the stack
+	UINT32 calls; // functions only; times called directly by a hook
+	UINT32 allocs;
+	size_t allocbytes;
+} profentry_t;
+
+typedef struct
+{
+	profentry_t *entries;
+	INT32 numentries, maxentries;
+	INT32 *slots; // index into entries plus one, 0 for empty slots
+	INT32 numslots;
+} proftable_t;
+
+static proftable_t proffunctions; // key: source and line defined, C function name, or hook name
+static proftable_t proflines; // key: function entry and line
+static proftable_t profstacks; // key: function entries, root first
+
+typedef struct
+{
+	INT32 hook; // function entry for the hook's name
+	INT32 func; // function entry for the function the hook called
+	int basedepth; // stack levels that were already there when the hook was called
+} profcontext_t;
+
+// Hook calls currently running, outermost first. Hooks nested deeper than
+// PROFILE_MAXHOOKS are counted but not profiled.
+static profcontext_t profcontexts[PROFILE_MAXHOOKS];
+static int numprofcontexts = 0;
+
+// Time and allocations not yet charged to anything
+static precise_t proflastcharge;
+static UINT32 proflastallocs;
+static size_t proflastallocbytes;
+
+static int profinterval = PROFILE_DEFAULTINTERVAL;
+static precise_t proftotal = 0;
+
+static UINT32 LUA_ProfileHash(const void *key, size_t keylen)
+{
+	const UINT8 *p = key;
+	UINT32 hash = 2166136261u; // FNV-1a
+
+	while (keylen--)
+		hash = (hash ^ *p++) * 16777619u;
+
+	return hash;
+}
+
+static void LUA_ProfileRehash(proftable_t *t)
+{
+	INT32 i, slot;
+
+	if (t->slots)
+		Z_Free(t->slots);
+
+	t->numslots = t->numslots ? t->numslots * 2 : 256;
+	t->slots = Z_Calloc(t->numslots * sizeof (*t->slots), PU_STATIC, NULL);
+
+	for (i = 0; i < t->numentries; i++)
+	{
+		slot = t->entries[i].hash & (t->numslots - 1);
+		while (t->slots[slot])
+			slot = (slot + 1) & (t->numslots - 1);
+		t->slots[slot] = i + 1;
+	}
+}
+
+/** Finds an entry in a profiler table, adding it if it isn't there.
+  * Adding entries may move the other entries of the same table.
+  *
+  * \param t Table to look in.
+  * \param key Key of the entry.
+  * \param keylen Length of the key in bytes.
+  * \param added Set to whether the entry had to be added.
+  * \return Index of the entry.
+  */
+static INT32 LUA_ProfileFind(proftable_t *t, const void *key, size_t keylen, boolean *added)
+{
+	const UINT32 hash = LUA_ProfileHash(key, keylen);
+	profentry_t *e;
+	INT32 slot;
+
+	if (t->numentries * 2 >= t->numslots)
+		LUA_ProfileRehash(t);
+
+	for (slot = hash & (t->numslots - 1); t->slots[slot]; slot = (slot + 1) & (t->numslots - 1))
+	{
+		e = &t->entries[t->slots[slot] - 1];
+		if (e->hash == hash && e->keylen == keylen && !memcmp(e->key, key, keylen))
+		{
+			*added = false;
+			return t->slots[slot] - 1;
+		}
+	}
+
+	if (t->numentries == t->maxentries)
+	{
+		t->maxentries = t->maxentries ? t->maxentries * 2 : 256;
+		t->entries = Z_Realloc(t->entries, t->maxentries * sizeof (*t->entries), PU_STATIC, NULL);
+	}
+
+	e = &t->entries[t->numentries];
+	memset(e, 0, sizeof (*e));
+	e->key = Z_Malloc(keylen, PU_STATIC, NULL);
+	memcpy(e->key, key, keylen);
+	e->keylen = keylen;
+	e->hash = hash;
+
+	t->slots[slot] = ++t->numentries;
+	*added = true;
+	return t->numentries - 1;
+}
+
+static void LUA_ProfileClearTable(proftable_t *t)
+{
+	INT32 i;
+
+	for (i = 0; i < t->numentries; i++)
+	{
+		Z_Free(t->entries[i].key);
+		if (t->entries[i].label)
+			Z_Free(t->entries[i].label);
+	}
+
+	if (t->entries)
+		Z_Free(t->entries);
+	if (t->slots)
+		Z_Free(t->slots);
+	memset(t, 0, sizeof (*t));
+}
+
+static void LUA_ProfileSetLabel(profentry_t *e, const char *label)
+{
+	char *p;
+
+	if (e->label)
+		Z_Free(e->label);
+	e->label = Z_StrDup(label);
+
+	// Semicolons separate frames in folded stacks
+	for (p = e->label; *p; p++)
+		if (*p == ';')
+			*p = ':';
+}
+
+// Finds the function entry for the function described by ar,
+// which needs the 'S' and 'n' fields filled in.
+static INT32 LUA_ProfileFunction(lua_Debug *ar)
+{
+	char key[LUA_IDSIZE + 64];
+	size_t len = strlen(ar->short_src) + 1;
+	profentry_t *e;
+	boolean added;
+	INT32 id;
+
+	memcpy(key, ar->short_src, len);
+	if (*ar->what == 'C') // no line to tell them apart by, so use the name
+	{
+		strlcpy(key + len, ar->name ? ar->name : "?", 64);
+		len += strlen(key + len);
+	}
+	else
+	{
+		memcpy(key + len, &ar->linedefined, sizeof (ar->linedefined));
+		len += sizeof (ar->linedefined);
+	}
+
+	id = LUA_ProfileFind(&proffunctions, key, len, &added);
+	e = &proffunctions.entries[id];
+
+	if (added || (!e->named && ar->name))
+	{
+		if (*ar->what == 'C')
+			LUA_ProfileSetLabel(e, va("[C] %s", ar->name ? ar->name : "?"));
+		else if (*ar->what == 'm')
+			LUA_ProfileSetLabel(e, va("main chunk (%s)", ar->short_src));
+		else if (*ar->what == 't')
+			LUA_ProfileSetLabel(e, "(tail call)");
+		else if (ar->name)
+			LUA_ProfileSetLabel(e, va("%s (%s:%d)", ar->name, ar->short_src, ar->linedefined));
+		else
+			LUA_ProfileSetLabel(e, va("%s:%d", ar->short_src, ar->linedefined));
+		e->named = (ar->name != NULL || *ar->what != 'L');
+	}
+
+	return id;
+}
+
+// Finds the function entry standing in for a hook.
+static INT32 LUA_ProfileHookEntry(const char *hookname, const char *string)
+{
+	const char *label = string ? va("%s:%s", hookname, string) : hookname;
+	char key[256];
+	size_t len;
+	boolean added;
+	INT32 id;
+
+	// Starting with a zero byte sets them apart from the functions
+	key[0] = '\0';
+	strlcpy(key + 1, label, sizeof (key) - 1);
+	len = strlen(key + 1) + 1;
+
+	id = LUA_ProfileFind(&proffunctions, key, len, &added);
+	if (added)
+	{
+		LUA_ProfileSetLabel(&proffunctions.entries[id], label);
+		proffunctions.entries[id].named = true;
+	}
+
+	return id;
+}
+
+static int LUA_ProfileDepth(lua_State *L)
+{
+	lua_Debug ar;
+	int depth = 0;
+
+	while (lua_getstack(L, depth, &ar))
+		depth++;
+
+	return depth;
+}
+
+static void LUA_ProfileResetCharge(void)
+{
+	proflastcharge = I_GetPreciseTime();
+	proflastallocs = lua_profileallocs;
+	proflastallocbytes = lua_profileallocbytes;
+}
+
+/** Charges the time and allocations since the last charge to a stack.
+  *
+  * \param stack Function entries, root first.
+  * \param depth Number of entries in stack.
+  * \param line Line being run in the last function, or -1 if unknown.
+  */
+static void LUA_ProfileCharge(const INT32 *stack, int depth, int line)
+{
+	const precise_t weight = I_GetPreciseTime() - proflastcharge;
+	const UINT32 allocs = lua_profileallocs - proflastallocs;
+	const size_t allocbytes = lua_profileallocbytes - proflastallocbytes;
+	profentry_t *e;
+	boolean added;
+	INT32 id;
+	int i, j;
+
+	LUA_ProfileResetCharge();
+
+	if (!depth)
+		return;
+
+	proftotal += weight;
+
+	id = LUA_ProfileFind(&profstacks, stack, depth * sizeof (*stack), &added);
+	e = &profstacks.entries[id];
+	e->self += weight;
+	e->allocs += allocs;
+	e->allocbytes += allocbytes;
+
+	e = &proffunctions.entries[stack[depth - 1]];
+	e->self += weight;
+	e->allocs += allocs;
+	e->allocbytes += allocbytes;
+
+	// Count recursive functions only once towards their total
+	for (i = 0; i < depth; i++)
+	{
+		for (j = 0; j < i; j++)
+			if (stack[j] == stack[i])
+				break;
+		if (j == i)
+			proffunctions.entries[stack[i]].total += weight;
+	}
+
+	if (line >= 0)
+	{
+		const INT32 key[2] = {stack[depth - 1], line};
+		id = LUA_ProfileFind(&proflines, key, sizeof (key), &added);
+		e = &proflines.entries[id];
+		e->self += weight;
+		e->allocs += allocs;
+		e->allocbytes += allocbytes;
+	}
+}
+
+// Writes the hooks currently running into stack, and returns how many
+// entries were written. The function the innermost hook called is left
+// out if withfunc is false.
+static int LUA_ProfileContextStack(INT32 *stack, boolean withfunc)
+{
+	int i, depth = 0;
+
+	for (i = 0; i < numprofcontexts; i++)
+	{
+		stack[depth++] = profcontexts[i].hook;
+		if (withfunc || i < numprofcontexts - 1)
+			stack[depth++] = profcontexts[i].func;
+	}
+
+	return depth;
+}
+
+// Charges everything since the last charge to the innermost hook function.
+static void LUA_ProfileChargeContext(void)
+{
+	INT32 stack[PROFILE_MAXHOOKS * 2];
+
+	if (numprofcontexts > PROFILE_MAXHOOKS)
+		LUA_ProfileResetCharge();
+	else
+		LUA_ProfileCharge(stack, LUA_ProfileContextStack(stack, true), -1);
+}
+
+static void LUA_ProfileSample(lua_State *L, lua_Debug *ar)
+{
+	INT32 stack[PROFILE_MAXDEPTH + PROFILE_MAXHOOKS * 2];
+	lua_Debug frame;
+	int depth, levels, level, line = -1;
+
+	(void)ar;
+
+	if (!lua_profiling)
+	{
+		// Coroutines made while profiling keep the hook around
+		lua_sethook(L, NULL, 0, 0);
+		return;
+	}
+
+	// Lua that isn't run by a hook isn't profiled
+	if (!numprofcontexts || numprofcontexts > PROFILE_MAXHOOKS)
+	{
+		LUA_ProfileResetCharge();
+		return;
+	}
+
+	depth = LUA_ProfileContextStack(stack, false);
+
+	// In the main thread, only the frames above the innermost hook belong to it.
+	// Coroutines have a stack of their own.
+	levels = LUA_ProfileDepth(L);
+	if (L == gL)
+		levels -= profcontexts[numprofcontexts - 1].basedepth;
+	levels = min(levels, PROFILE_MAXDEPTH);
+
+	for (level = levels - 1; level >= 0; level--)
+	{
+		if (!lua_getstack(L, level, &frame) || !lua_getinfo(L, "Snl", &frame))
+			continue;
+		stack[depth++] = LUA_ProfileFunction(&frame);
+		if (level == 0)
+			line = frame.currentline;
+	}
+
+	LUA_ProfileCharge(stack, depth, line);
+}
+
+void LUA_ProfileHookStart(lua_State *L, int idx, const char *hookname, const char *string)
+{
+	profcontext_t *context;
+	lua_Debug ar;
+
+	// The Lua state may have been remade since profiling started
+	if (lua_gethook(L) != LUA_ProfileSample)
+		lua_sethook(L, LUA_ProfileSample, LUA_MASKCOUNT, profinterval);
+
+	// Whatever the enclosing hook did up to here is its own
+	if (numprofcontexts)
+		LUA_ProfileChargeContext();
+
+	if (++numprofcontexts > PROFILE_MAXHOOKS)
+		return;
+
+	context = &profcontexts[numprofcontexts - 1];
+	context->hook = LUA_ProfileHookEntry(hookname, string);
+
+	lua_pushvalue(L, idx);
+	lua_getinfo(L, ">S", &ar);
+	ar.name = NULL;
+	context->func = LUA_ProfileFunction(&ar);
+	context->basedepth = LUA_ProfileDepth(L);
+
+	proffunctions.entries[context->hook].calls++;
+	proffunctions.entries[context->func].calls++;
+
+	LUA_ProfileResetCharge();
+}
+
+void LUA_ProfileHookEnd(void)
+{
+	// Profiling may have been started or stopped while the hook ran
+	if (!numprofcontexts)
+		return;
+
+	LUA_ProfileChargeContext();
+	numprofcontexts--;
+}
+
+/* =========================================================================
+                                    COMMANDS
+   ========================================================================= */
+
+static proftable_t *sorttable;
+
+static int LUA_ProfileCompareSelf(const void *a, const void *b)
+{
+	const precise_t sa = sorttable->entries[*(const INT32 *)a].self;
+	const precise_t sb = sorttable->entries[*(const INT32 *)b].self;
+	return (sa < sb) - (sa > sb);
+}
+
+// Returns the entries of t sorted by self time, biggest first. Z_Free it when done.
+static INT32 *LUA_ProfileSortBySelf(proftable_t *t)
+{
+	INT32 *order = Z_Malloc(max(t->numentries, 1) * sizeof (*order), PU_STATIC, NULL);
+	INT32 i;
+
+	for (i = 0; i < t->numentries; i++)
+		order[i] = i;
+
+	sorttable = t;
+	qsort(order, t->numentries, sizeof (*order), LUA_ProfileCompareSelf);
+	return order;
+}
+
+static double LUA_ProfileMilliseconds(precise_t t)
+{
+	return (double)t * 1000.0 / I_GetPrecisePrecision();
+}
+
+static void LUA_ProfileReport(INT32 count)
+{
+	INT32 *order = LUA_ProfileSortBySelf(&proffunctions);
+	INT32 i;
+
+	CONS_Printf("%.2f ms profiled\n", LUA_ProfileMilliseconds(proftotal));
+	CONS_Printf("  self ms  total ms   calls  allocs      KB  function\n");
+
+	for (i = 0; i < min(count, proffunctions.numentries); i++)
+	{
+		const profentry_t *e = &proffunctions.entries[order[i]];
+		CONS_Printf("%9.2f %9.2f %7u %7u %7s  %s\n",
+			LUA_ProfileMilliseconds(e->self), LUA_ProfileMilliseconds(e->total),
+			e->calls, e->allocs, sizeu1(e->allocbytes / 1024), e->label);
+	}
+
+	Z_Free(order);
+}
+
+static void LUA_ProfileReportLines(INT32 count)
+{
+	INT32 *order = LUA_ProfileSortBySelf(&proflines);
+	INT32 i;
+
+	CONS_Printf("  self ms  allocs      KB  line\n");
+
+	for (i = 0; i < min(count, proflines.numentries); i++)
+	{
+		const profentry_t *e = &proflines.entries[order[i]];
+		const INT32 *key = e->key;
+		CONS_Printf("%9.2f %7u %7s  %s, line %d\n",
+			LUA_ProfileMilliseconds(e->self), e->allocs, sizeu1(e->allocbytes / 1024),
+			proffunctions.entries[key[0]].label, key[1]);
+	}
+
+	Z_Free(order);
+}
+
+// Writes the stacks in the folded format flamegraph.pl and friends read,
+// one "root;...;leaf microseconds" line per stack.
+static void LUA_ProfileDump(const char *filename)
+{
+	const char *path = va(pandf, srb2home, filename);
+	FILE *f = fopen(path, "w");
+	INT32 i, j;
+
+	if (!f)
+	{
+		CONS_Alert(CONS_ERROR, M_GetText("Can't write to %s\n"), path);
+		return;
+	}
+
+	for (i = 0; i < profstacks.numentries; i++)
+	{
+		const profentry_t *e = &profstacks.entries[i];
+		const INT32 *stack = e->key;
+		const double us = LUA_ProfileMilliseconds(e->self) * 1000.0;
+
+		if (us < 1.0)
+			continue;
+
+		for (j = 0; j < (INT32)(e->keylen / sizeof (*stack)); j++)
+			fprintf(f, j ? ";%s" : "%s", proffunctions.entries[stack[j]].label);
+		fprintf(f, " %.0f\n", us);
+	}
+
+	fclose(f);
+	CONS_Printf(M_GetText("Lua profile written to %s\n"), path);
+}
+
+static void LUA_ProfileReset(void)
+{
+	LUA_ProfileClearTable(&proffunctions);
+	LUA_ProfileClearTable(&proflines);
+	LUA_ProfileClearTable(&profstacks);
+	numprofcontexts = 0;
+	proftotal = 0;
+}
+
+void Command_LuaProfile_f(void)
+{
+	const char *cmd = COM_Argv(1);
+
+	if (!stricmp(cmd, "start"))
+	{
+		profinterval = (COM_Argc() > 2) ? max(1, atoi(COM_Argv(2))) : PROFILE_DEFAULTINTERVAL;
+		lua_profiling = true;
+		numprofcontexts = 0;
+		if (gL)
+			lua_sethook(gL, LUA_ProfileSample, LUA_MASKCOUNT, profinterval);
+		CONS_Printf(M_GetText("Lua profiling started, sampling every %d instructions.\n"), profinterval);
+	}
+	else if (!stricmp(cmd, "stop"))
+	{
+		lua_profiling = false;
+		numprofcontexts = 0;
+		if (gL)
+			lua_sethook(gL, NULL, 0, 0);
+		CONS_Printf(M_GetText("Lua profiling stopped.\n"));
+	}
+	else if (!stricmp(cmd, "reset"))
+		LUA_ProfileReset();
+	else if (!stricmp(cmd, "report"))
+		LUA_ProfileReport((COM_Argc() > 2) ? atoi(COM_Argv(2)) : PROFILE_DEFAULTREPORT);
+	else if (!stricmp(cmd, "lines"))
+		LUA_ProfileReportLines((COM_Argc() > 2) ? atoi(COM_Argv(2)) : PROFILE_DEFAULTREPORT);
+	else if (!stricmp(cmd, "dump") && COM_Argc() > 2)
+		LUA_ProfileDump(COM_Argv(2));
+	else
+	{
+		CONS_Printf(M_GetText(
+			"luaprofile start [instructions]: Profile Lua hooks, sampling the Lua stack every so many instructions\n"
+			"luaprofile stop: Stop profiling\n"
+			"luaprofile reset: Throw away everything profiled so far\n"
+			"luaprofile report [count]: Show the functions that took the most time\n"
+			"luaprofile lines [count]: Show the lines that took the most time\n"
+			"luaprofile dump <filename>: Write the profiled stacks to a file, for use with flamegraph tools\n"));
+	}
+}
@@ -0,0 +1,54 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 2024 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  lua_profile.h
+/// \brief Sampling profiler for Lua hooks
+
+// While running, the profiler times every hook call from the engine side,
+// and every few thousand Lua instructions it walks the Lua stack to find
+// out which functions and lines the time since the last sample went to.
+// The results can be printed to the console, or dumped as folded stacks
+// that flamegraph tools understand.
+
+#ifndef __LUA_PROFILE__
+#define __LUA_PROFILE__
+
+#include "doomtype.h"
+#include "blua/lua.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern boolean lua_profiling;
+
+// Allocation counters, bumped by LUA_Alloc while the profiler is running.
+extern UINT32 lua_profileallocs;
+extern size_t lua_profileallocbytes;
+
+/** Marks the start of a hook call.
+  * The hook function must be at stack index idx of L.
+  * Only call this while ::lua_profiling is set.
+  *
+  * \param L Lua state the hook is being called in.
+  * \param idx Stack index of the hook function.
+  * \param hookname Name of the hook, e.g. "MobjThinker".
+  * \param string Extra string the hook was called for, or NULL.
+  */
+void LUA_ProfileHookStart(lua_State *L, int idx, const char *hookname, const char *string);
+
+// Marks the end of the hook call started last.
+void LUA_ProfileHookEnd(void);
+
+void Command_LuaProfile_f(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // __LUA_PROFILE__
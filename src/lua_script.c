@@ -34,11 +34,14 @@
 #include "lua_script.h"
 #include "lua_libs.h"
 #include "lua_hook.h"
+#include "lua_profile.h"
 
 #include "doomstat.h"
 #include "g_state.h"
 
 #include "hu_stuff.h"
+#include "i_system.h" // I_GetPreciseTime
+#include "m_perfstats.h"
 
 lua_State *gL = NULL;
 
@@ -59,14 +62,158 @@ static lua_CFunction liblist[] = {
 	LUA_TagLib, // tags
 	LUA_PolyObjLib, // polyobj_t
 	LUA_BlockmapLib, // blockmap stuff
+	LUA_TaskLib, // addTask, cancelTask
 	LUA_HudLib, // HUD stuff
 	LUA_ColorLib, // general color functions
 	LUA_InputLib, // inputs
 	NULL
 };
 
-// Lua asks for memory using this.
+//
+// Small-object pool for the Lua VM
+//
+// Most of what Lua allocates (strings, tables, closures, upvalues) is only
+// a few dozen bytes, and giving each its own zone block costs a header and
+// a trip through the zone list on every allocation and free. Blocks of up
+// to LUA_POOLMAXSIZE bytes instead come from size classes LUA_POOLGRAIN
+// bytes apart, carved out of pages that are themselves PU_LUA zone blocks,
+// so they still show up under Lua in memfree. Freed blocks go on a free
+// list for their class and pages are kept for reuse until the Lua state
+// is closed, when LUA_PoolClear hands them all back to the zone. Each
+// Lua state has its own pool, passed to LUA_Alloc as its userdata, so
+// closing one state never takes pages from another. Lua always runs on
+// the main thread, so the free lists need no locking.
+//
+// Lua tells the allocator the old size of every block it frees or resizes,
+// which is all it takes to find the block's class again.
+//
+
+#define LUA_POOLGRAIN 16
+#define LUA_POOLMAXSIZE 256
+#define LUA_POOLCLASSES (LUA_POOLMAXSIZE / LUA_POOLGRAIN)
+#define LUA_POOLPAGESIZE 16384
+
+typedef struct luapoolblock_s
+{
+	struct luapoolblock_s *next;
+} luapoolblock_t;
+
+typedef struct
+{
+	luapoolblock_t *free[LUA_POOLCLASSES];
+	void **pages; // every page carved so far
+	size_t numpages, pages_max;
+} luapool_t;
+
+static luapool_t luapool; // gL's
+
+static inline size_t LUA_PoolClass(size_t size)
+{
+	return (size - 1) / LUA_POOLGRAIN;
+}
+
+static void *LUA_PoolGet(luapool_t *pool, size_t size)
+{
+	size_t class = LUA_PoolClass(size);
+	luapoolblock_t *block = pool->free[class];
+
+	if (!block)
+	{
+		// Carve a fresh page into blocks of this class
+		size_t blocksize = (class + 1) * LUA_POOLGRAIN;
+		size_t count = LUA_POOLPAGESIZE / blocksize, i;
+		UINT8 *page = Z_Malloc(count * blocksize, PU_LUA, NULL);
+
+		if (pool->numpages == pool->pages_max)
+		{
+			pool->pages_max = pool->pages_max ? pool->pages_max * 2 : 64;
+			pool->pages = Z_Realloc(pool->pages, pool->pages_max * sizeof (*pool->pages), PU_STATIC, NULL);
+		}
+		pool->pages[pool->numpages++] = page;
+
+		for (i = 0; i < count - 1; i++)
+			((luapoolblock_t *)(page + i*blocksize))->next = (luapoolblock_t *)(page + (i+1)*blocksize);
+		((luapoolblock_t *)(page + (count-1)*blocksize))->next = NULL;
+
+		block = (luapoolblock_t *)page;
+	}
+
+	pool->free[class] = block->next;
+	return block;
+}
+
+static inline void LUA_PoolPut(luapool_t *pool, void *ptr, size_t size)
+{
+	luapoolblock_t *block = ptr;
+	size_t class = LUA_PoolClass(size);
+
+	block->next = pool->free[class];
+	pool->free[class] = block;
+}
+
+// Frees every page, once the Lua state using the pool is closed.
+static void LUA_PoolClear(luapool_t *pool)
+{
+	size_t i;
+
+	for (i = 0; i < pool->numpages; i++)
+		Z_Free(pool->pages[i]);
+	pool->numpages = 0;
+
+	memset(pool->free, 0, sizeof (pool->free));
+}
+
+// Lua asks for memory using this, with the state's pool as ud.
 static void *LUA_Alloc(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+	luapool_t *pool = ud;
+	void *newptr;
+
+	if (!ptr)
+		osize = 0;
+
+	if (lua_profiling && nsize > osize)
+	{
+		if (!osize)
+			lua_profileallocs++;
+		lua_profileallocbytes += nsize - osize;
+	}
+
+	if (nsize == 0)
+	{
+		if (osize > LUA_POOLMAXSIZE)
+			Z_Free(ptr);
+		else if (osize != 0)
+			LUA_PoolPut(pool, ptr, osize);
+		return NULL;
+	}
+
+	if (osize > LUA_POOLMAXSIZE && nsize > LUA_POOLMAXSIZE)
+		return Z_Realloc(ptr, nsize, PU_LUA, NULL);
+
+	if (osize && nsize <= LUA_POOLMAXSIZE && LUA_PoolClass(osize) == LUA_PoolClass(nsize))
+		return ptr; // still fits its block
+
+	if (nsize <= LUA_POOLMAXSIZE)
+		newptr = LUA_PoolGet(pool, nsize);
+	else
+		newptr = Z_Malloc(nsize, PU_LUA, NULL);
+
+	if (osize)
+	{
+		M_Memcpy(newptr, ptr, min(osize, nsize));
+		if (osize > LUA_POOLMAXSIZE)
+			Z_Free(ptr);
+		else
+			LUA_PoolPut(pool, ptr, osize);
+	}
+
+	return newptr;
+}
+
+#ifdef DEVELOP
+// The zone-only allocator LUA_Alloc replaced, kept to compare against.
+static void *LUA_ZoneAlloc(void *ud, void *ptr, size_t osize, size_t nsize)
 {
 	(void)ud;
 	if (nsize == 0) {
@@ -77,6 +224,54 @@ static void *LUA_Alloc(void *ud, void *ptr, size_t osize, size_t nsize)
 		return Z_Realloc(ptr, nsize, PU_LUA, NULL);
 }
 
+static double LUA_TimeAllocBench(lua_Alloc allocf, luapool_t *pool, INT32 iterations)
+{
+	static const char *script =
+		"local n = ...\n"
+		"local keep = {}\n"
+		"for i = 1, n do\n"
+		"	local t = {x = i, y = -i, name = \"obj\" .. (i % 97)}\n"
+		"	local f = function() return t.x + t.y end\n"
+		"	keep[(i % 64) + 1] = {t, f, tostring(i)}\n"
+		"end\n";
+	lua_State *L = lua_newstate(allocf, pool);
+	precise_t start;
+
+	luaL_openlibs(L);
+	start = I_GetPreciseTime();
+
+	if (luaL_loadstring(L, script) == 0)
+	{
+		lua_pushinteger(L, iterations);
+		if (lua_pcall(L, 1, 0, 0) != 0)
+			CONS_Alert(CONS_ERROR, "%s\n", lua_tostring(L, -1));
+	}
+
+	lua_close(L);
+	if (pool)
+		LUA_PoolClear(pool);
+	return (double)(I_GetPreciseTime() - start) * 1000.0 / I_GetPrecisePrecision();
+}
+
+// luaallocbench [iterations]: runs the same GC-heavy script with both allocators.
+void Command_LuaAllocBench_f(void)
+{
+	INT32 iterations = COM_Argc() > 1 ? atoi(COM_Argv(1)) : 1000000;
+	luapool_t pool = {0};
+	double pooled, zone;
+
+	if (iterations <= 0)
+		iterations = 1000000;
+
+	zone = LUA_TimeAllocBench(LUA_ZoneAlloc, NULL, iterations);
+	pooled = LUA_TimeAllocBench(LUA_Alloc, &pool, iterations);
+	if (pool.pages)
+		Z_Free(pool.pages);
+
+	CONS_Printf("%d iterations: zone allocator %.2f ms, pooled allocator %.2f ms\n", iterations, zone, pooled);
+}
+#endif
+
 // Panic function Lua calls when there's an unprotected error.
 // This function cannot return. Lua would kill the application anyway if it did.
 FUNCNORETURN static int LUA_Panic(lua_State *L)
@@ -153,292 +348,533 @@ int LUA_Call(lua_State *L, int nargs, int nresults, int errorhandlerindex)
 	return err;
 }
 
+// Every global LUA_PushGlobals knows about, in the same order as global_opt.
+enum global_e {
+	global_gamemap,
+	global_udmf,
+	global_maptol,
+	global_ultimatemode,
+	global_mariomode,
+	global_twodlevel,
+	global_circuitmap,
+	global_stoppedclock,
+	global_netgame,
+	global_multiplayer,
+	global_modeattacking,
+	global_metalrecording,
+	global_splitscreen,
+	global_gamecomplete,
+	global_marathonmode,
+	global_devparm,
+	global_modifiedgame,
+	global_usedCheats,
+	global_menuactive,
+	global_paused,
+	global_bluescore,
+	global_redscore,
+	global_timelimit,
+	global_pointlimit,
+	global_redflag,
+	global_blueflag,
+	global_rflagpoint,
+	global_bflagpoint,
+	global_spstage_start,
+	global_spmarathon_start,
+	global_sstage_start,
+	global_sstage_end,
+	global_smpstage_start,
+	global_smpstage_end,
+	global_titlemap,
+	global_titlemapinaction,
+	global_bootmap,
+	global_tutorialmap,
+	global_tutorialmode,
+	global_skincolor_redteam,
+	global_skincolor_blueteam,
+	global_skincolor_redring,
+	global_skincolor_bluering,
+	global_invulntics,
+	global_sneakertics,
+	global_flashingtics,
+	global_tailsflytics,
+	global_underwatertics,
+	global_spacetimetics,
+	global_extralifetics,
+	global_nightslinktics,
+	global_gameovertics,
+	global_ammoremovaltics,
+	global_use1upSound,
+	global_maxXtraLife,
+	global_useContinues,
+	global_shareEmblems,
+	global_gametype,
+	global_gametyperules,
+	global_leveltime,
+	global_sstimer,
+	global_curWeather,
+	global_globalweather,
+	global_levelskynum,
+	global_globallevelskynum,
+	global_mapmusname,
+	global_mapmusflags,
+	global_mapmusposition,
+	global_consoleplayer,
+	global_displayplayer,
+	global_secondarydisplayplayer,
+	global_isserver,
+	global_isdedicatedserver,
+	global_server,
+	global_emeralds,
+	global_gravity,
+	global_VERSION,
+	global_SUBVERSION,
+	global_VERSIONSTRING,
+	global_token,
+	global_gamestate,
+	global_stagefailed,
+	global_mouse,
+	global_mouse2,
+	global_camera,
+	global_camera2,
+	global_chatactive,
+	global_max
+};
+
+static const char *const global_opt[] = {
+	"gamemap",
+	"udmf",
+	"maptol",
+	"ultimatemode",
+	"mariomode",
+	"twodlevel",
+	"circuitmap",
+	"stoppedclock",
+	"netgame",
+	"multiplayer",
+	"modeattacking",
+	"metalrecording",
+	"splitscreen",
+	"gamecomplete",
+	"marathonmode",
+	"devparm",
+	"modifiedgame",
+	"usedCheats",
+	"menuactive",
+	"paused",
+	"bluescore",
+	"redscore",
+	"timelimit",
+	"pointlimit",
+	"redflag",
+	"blueflag",
+	"rflagpoint",
+	"bflagpoint",
+	"spstage_start",
+	"spmarathon_start",
+	"sstage_start",
+	"sstage_end",
+	"smpstage_start",
+	"smpstage_end",
+	"titlemap",
+	"titlemapinaction",
+	"bootmap",
+	"tutorialmap",
+	"tutorialmode",
+	"skincolor_redteam",
+	"skincolor_blueteam",
+	"skincolor_redring",
+	"skincolor_bluering",
+	"invulntics",
+	"sneakertics",
+	"flashingtics",
+	"tailsflytics",
+	"underwatertics",
+	"spacetimetics",
+	"extralifetics",
+	"nightslinktics",
+	"gameovertics",
+	"ammoremovaltics",
+	"use1upSound",
+	"maxXtraLife",
+	"useContinues",
+	"shareEmblems",
+	"gametype",
+	"gametyperules",
+	"leveltime",
+	"sstimer",
+	"curWeather",
+	"globalweather",
+	"levelskynum",
+	"globallevelskynum",
+	"mapmusname",
+	"mapmusflags",
+	"mapmusposition",
+	"consoleplayer",
+	"displayplayer",
+	"secondarydisplayplayer",
+	"isserver",
+	"isdedicatedserver",
+	"server",
+	"emeralds",
+	"gravity",
+	"VERSION",
+	"SUBVERSION",
+	"VERSIONSTRING",
+	"token",
+	"gamestate",
+	"stagefailed",
+	"mouse",
+	"mouse2",
+	"camera",
+	"camera2",
+	"chatactive",
+	NULL};
+
+// The globals are looked up on every access from Lua, so rather than
+// comparing the name against all of them in turn, find it in a small
+// open-addressed hash table that is filled in the first time it's needed.
+#define GLOBALHASHSIZE 256 // must be a power of two, and at least twice global_max
+static UINT8 globalhash[GLOBALHASHSIZE]; // index into global_opt plus one, 0 for empty slots
+static boolean globalhashready = false;
+
+static UINT32 LUA_HashGlobalName(const char *word)
+{
+	UINT32 hash = 2166136261u; // FNV-1a
+
+	for (; *word; word++)
+		hash = (hash ^ (UINT8)*word) * 16777619u;
+
+	return hash;
+}
+
+static void LUA_BuildGlobalHash(void)
+{
+	UINT32 slot;
+	int i;
+
+	for (i = 0; i < global_max; i++)
+	{
+		slot = LUA_HashGlobalName(global_opt[i]) & (GLOBALHASHSIZE - 1);
+		while (globalhash[slot])
+			slot = (slot + 1) & (GLOBALHASHSIZE - 1);
+		globalhash[slot] = (UINT8)(i + 1);
+	}
+
+	globalhashready = true;
+}
+
+/** Finds which global a name refers to.
+  *
+  * \param word Name to look up.
+  * \return The global's ::global_e entry, or -1 if there is no such global.
+  */
+static int LUA_GetGlobalIndex(const char *word)
+{
+	UINT32 slot;
+
+	if (!globalhashready)
+		LUA_BuildGlobalHash();
+
+	slot = LUA_HashGlobalName(word) & (GLOBALHASHSIZE - 1);
+	while (globalhash[slot])
+	{
+		if (fastcmp(word, global_opt[globalhash[slot] - 1]))
+			return globalhash[slot] - 1;
+		slot = (slot + 1) & (GLOBALHASHSIZE - 1);
+	}
+
+	return -1;
+}
+
 // Moved here from lib_getenum.
 int LUA_PushGlobals(lua_State *L, const char *word)
 {
-	if (fastcmp(word,"gamemap")) {
+	switch (LUA_GetGlobalIndex(word))
+	{
+	case global_gamemap:
 		lua_pushinteger(L, gamemap);
 		return 1;
-	} else if (fastcmp(word,"udmf")) {
+	case global_udmf:
 		lua_pushboolean(L, udmf);
 		return 1;
-	} else if (fastcmp(word,"maptol")) {
+	case global_maptol:
 		lua_pushinteger(L, maptol);
 		return 1;
-	} else if (fastcmp(word,"ultimatemode")) {
+	case global_ultimatemode:
 		lua_pushboolean(L, ultimatemode != 0);
 		return 1;
-	} else if (fastcmp(word,"mariomode")) {
+	case global_mariomode:
 		lua_pushboolean(L, mariomode != 0);
 		return 1;
-	} else if (fastcmp(word,"twodlevel")) {
+	case global_twodlevel:
 		lua_pushboolean(L, twodlevel != 0);
 		return 1;
-	} else if (fastcmp(word,"circuitmap")) {
+	case global_circuitmap:
 		lua_pushboolean(L, circuitmap);
 		return 1;
-	} else if (fastcmp(word,"stoppedclock")) {
+	case global_stoppedclock:
 		lua_pushboolean(L, stoppedclock);
 		return 1;
-	} else if (fastcmp(word,"netgame")) {
+	case global_netgame:
 		lua_pushboolean(L, netgame);
 		return 1;
-	} else if (fastcmp(word,"multiplayer")) {
+	case global_multiplayer:
 		lua_pushboolean(L, multiplayer);
 		return 1;
-	} else if (fastcmp(word,"modeattacking")) {
+	case global_modeattacking:
 		lua_pushboolean(L, modeattacking);
 		return 1;
-	} else if (fastcmp(word,"metalrecording")) {
+	case global_metalrecording:
 		lua_pushboolean(L, metalrecording);
 		return 1;
-	} else if (fastcmp(word,"splitscreen")) {
+	case global_splitscreen:
 		lua_pushboolean(L, splitscreen);
 		return 1;
-	} else if (fastcmp(word,"gamecomplete")) {
+	case global_gamecomplete:
 		lua_pushboolean(L, (gamecomplete != 0));
 		return 1;
-	} else if (fastcmp(word,"marathonmode")) {
+	case global_marathonmode:
 		lua_pushinteger(L, marathonmode);
 		return 1;
-	} else if (fastcmp(word,"devparm")) {
+	case global_devparm:
 		lua_pushboolean(L, devparm);
 		return 1;
-	} else if (fastcmp(word,"modifiedgame")) {
+	case global_modifiedgame:
 		lua_pushboolean(L, modifiedgame && !savemoddata);
 		return 1;
-	} else if (fastcmp(word,"usedCheats")) {
+	case global_usedCheats:
 		lua_pushboolean(L, usedCheats);
 		return 1;
-	} else if (fastcmp(word,"menuactive")) {
+	case global_menuactive:
 		lua_pushboolean(L, menuactive);
 		return 1;
-	} else if (fastcmp(word,"paused")) {
+	case global_paused:
 		lua_pushboolean(L, paused);
 		return 1;
-	} else if (fastcmp(word,"bluescore")) {
+	case global_bluescore:
 		lua_pushinteger(L, bluescore);
 		return 1;
-	} else if (fastcmp(word,"redscore")) {
+	case global_redscore:
 		lua_pushinteger(L, redscore);
 		return 1;
-	} else if (fastcmp(word,"timelimit")) {
+	case global_timelimit:
 		lua_pushinteger(L, cv_timelimit.value);
 		return 1;
-	} else if (fastcmp(word,"pointlimit")) {
+	case global_pointlimit:
 		lua_pushinteger(L, cv_pointlimit.value);
 		return 1;
-	} else if (fastcmp(word, "redflag")) {
+	case global_redflag:
 		LUA_PushUserdata(L, redflag, META_MOBJ);
 		return 1;
-	} else if (fastcmp(word, "blueflag")) {
+	case global_blueflag:
 		LUA_PushUserdata(L, blueflag, META_MOBJ);
 		return 1;
-	} else if (fastcmp(word, "rflagpoint")) {
+	case global_rflagpoint:
 		LUA_PushUserdata(L, rflagpoint, META_MAPTHING);
 		return 1;
-	} else if (fastcmp(word, "bflagpoint")) {
+	case global_bflagpoint:
 		LUA_PushUserdata(L, bflagpoint, META_MAPTHING);
 		return 1;
 	// begin map vars
-	} else if (fastcmp(word,"spstage_start")) {
+	case global_spstage_start:
 		lua_pushinteger(L, spstage_start);
 		return 1;
-	} else if (fastcmp(word,"spmarathon_start")) {
+	case global_spmarathon_start:
 		lua_pushinteger(L, spmarathon_start);
 		return 1;
-	} else if (fastcmp(word,"sstage_start")) {
+	case global_sstage_start:
 		lua_pushinteger(L, sstage_start);
 		return 1;
-	} else if (fastcmp(word,"sstage_end")) {
+	case global_sstage_end:
 		lua_pushinteger(L, sstage_end);
 		return 1;
-	} else if (fastcmp(word,"smpstage_start")) {
+	case global_smpstage_start:
 		lua_pushinteger(L, smpstage_start);
 		return 1;
-	} else if (fastcmp(word,"smpstage_end")) {
+	case global_smpstage_end:
 		lua_pushinteger(L, smpstage_end);
 		return 1;
-	} else if (fastcmp(word,"titlemap")) {
+	case global_titlemap:
 		lua_pushinteger(L, titlemap);
 		return 1;
-	} else if (fastcmp(word,"titlemapinaction")) {
+	case global_titlemapinaction:
 		lua_pushboolean(L, (titlemapinaction != TITLEMAP_OFF));
 		return 1;
-	} else if (fastcmp(word,"bootmap")) {
+	case global_bootmap:
 		lua_pushinteger(L, bootmap);
 		return 1;
-	} else if (fastcmp(word,"tutorialmap")) {
+	case global_tutorialmap:
 		lua_pushinteger(L, tutorialmap);
 		return 1;
-	} else if (fastcmp(word,"tutorialmode")) {
+	case global_tutorialmode:
 		lua_pushboolean(L, tutorialmode);
 		return 1;
 	// end map vars
 	// begin CTF colors
-	} else if (fastcmp(word,"skincolor_redteam")) {
+	case global_skincolor_redteam:
 		lua_pushinteger(L, skincolor_redteam);
 		return 1;
-	} else if (fastcmp(word,"skincolor_blueteam")) {
+	case global_skincolor_blueteam:
 		lua_pushinteger(L, skincolor_blueteam);
 		return 1;
-	} else if (fastcmp(word,"skincolor_redring")) {
+	case global_skincolor_redring:
 		lua_pushinteger(L, skincolor_redring);
 		return 1;
-	} else if (fastcmp(word,"skincolor_bluering")) {
+	case global_skincolor_bluering:
 		lua_pushinteger(L, skincolor_bluering);
 		return 1;
 	// end CTF colors
 	// begin timers
-	} else if (fastcmp(word,"invulntics")) {
+	case global_invulntics:
 		lua_pushinteger(L, invulntics);
 		return 1;
-	} else if (fastcmp(word,"sneakertics")) {
+	case global_sneakertics:
 		lua_pushinteger(L, sneakertics);
 		return 1;
-	} else if (fastcmp(word,"flashingtics")) {
+	case global_flashingtics:
 		lua_pushinteger(L, flashingtics);
 		return 1;
-	} else if (fastcmp(word,"tailsflytics")) {
+	case global_tailsflytics:
 		lua_pushinteger(L, tailsflytics);
 		return 1;
-	} else if (fastcmp(word,"underwatertics")) {
+	case global_underwatertics:
 		lua_pushinteger(L, underwatertics);
 		return 1;
-	} else if (fastcmp(word,"spacetimetics")) {
+	case global_spacetimetics:
 		lua_pushinteger(L, spacetimetics);
 		return 1;
-	} else if (fastcmp(word,"extralifetics")) {
+	case global_extralifetics:
 		lua_pushinteger(L, extralifetics);
 		return 1;
-	} else if (fastcmp(word,"nightslinktics")) {
+	case global_nightslinktics:
 		lua_pushinteger(L, nightslinktics);
 		return 1;
-	} else if (fastcmp(word,"gameovertics")) {
+	case global_gameovertics:
 		lua_pushinteger(L, gameovertics);
 		return 1;
-	} else if (fastcmp(word,"ammoremovaltics")) {
+	case global_ammoremovaltics:
 		lua_pushinteger(L, ammoremovaltics);
 		return 1;
 	// end timers
-	} else if (fastcmp(word,"use1upSound")) {
+	case global_use1upSound:
 		lua_pushinteger(L, use1upSound);
 		return 1;
-	} else if (fastcmp(word,"maxXtraLife")) {
+	case global_maxXtraLife:
 		lua_pushinteger(L, maxXtraLife);
 		return 1;
-	} else if (fastcmp(word,"useContinues")) {
+	case global_useContinues:
 		lua_pushinteger(L, useContinues);
 		return 1;
-	} else if (fastcmp(word,"shareEmblems")) {
+	case global_shareEmblems:
 		lua_pushinteger(L, shareEmblems);
 		return 1;
-	} else if (fastcmp(word,"gametype")) {
+	case global_gametype:
 		lua_pushinteger(L, gametype);
 		return 1;
-	} else if (fastcmp(word,"gametyperules")) {
+	case global_gametyperules:
 		lua_pushinteger(L, gametyperules);
 		return 1;
-	} else if (fastcmp(word,"leveltime")) {
+	case global_leveltime:
 		lua_pushinteger(L, leveltime);
 		return 1;
-	} else if (fastcmp(word,"sstimer")) {
+	case global_sstimer:
 		lua_pushinteger(L, sstimer);
 		return 1;
-	} else if (fastcmp(word,"curWeather")) {
+	case global_curWeather:
 		lua_pushinteger(L, curWeather);
 		return 1;
-	} else if (fastcmp(word,"globalweather")) {
+	case global_globalweather:
 		lua_pushinteger(L, globalweather);
 		return 1;
-	} else if (fastcmp(word,"levelskynum")) {
+	case global_levelskynum:
 		lua_pushinteger(L, levelskynum);
 		return 1;
-	} else if (fastcmp(word,"globallevelskynum")) {
+	case global_globallevelskynum:
 		lua_pushinteger(L, globallevelskynum);
 		return 1;
-	} else if (fastcmp(word,"mapmusname")) {
+	case global_mapmusname:
 		lua_pushstring(L, mapmusname);
 		return 1;
-	} else if (fastcmp(word,"mapmusflags")) {
+	case global_mapmusflags:
 		lua_pushinteger(L, mapmusflags);
 		return 1;
-	} else if (fastcmp(word,"mapmusposition")) {
+	case global_mapmusposition:
 		lua_pushinteger(L, mapmusposition);
 		return 1;
 	// local player variables, by popular request
-	} else if (fastcmp(word,"consoleplayer")) { // player controlling console (aka local player 1)
+	case global_consoleplayer: // player controlling console (aka local player 1)
 		if (!addedtogame || consoleplayer < 0 || !playeringame[consoleplayer])
 			return 0;
 		LUA_PushUserdata(L, &players[consoleplayer], META_PLAYER);
 		return 1;
-	} else if (fastcmp(word,"displayplayer")) { // player visible on screen (aka display player 1)
+	case global_displayplayer: // player visible on screen (aka display player 1)
 		if (displayplayer < 0 || !playeringame[displayplayer])
 			return 0;
 		LUA_PushUserdata(L, &players[displayplayer], META_PLAYER);
 		return 1;
-	} else if (fastcmp(word,"secondarydisplayplayer")) { // local/display player 2, for splitscreen
+	case global_secondarydisplayplayer: // local/display player 2, for splitscreen
 		if (!splitscreen || secondarydisplayplayer < 0 || !playeringame[secondarydisplayplayer])
 			return 0;
 		LUA_PushUserdata(L, &players[secondarydisplayplayer], META_PLAYER);
 		return 1;
-	} else if (fastcmp(word,"isserver")) {
+	case global_isserver:
 		lua_pushboolean(L, server);
 		return 1;
-	} else if (fastcmp(word,"isdedicatedserver")) {
+	case global_isdedicatedserver:
 		lua_pushboolean(L, dedicated);
 		return 1;
 	// end local player variables
-	} else if (fastcmp(word,"server")) {
+	case global_server:
 		if ((!multiplayer || !netgame) && !playeringame[serverplayer])
 			return 0;
 		LUA_PushUserdata(L, &players[serverplayer], META_PLAYER);
 		return 1;
-	} else if (fastcmp(word,"emeralds")) {
+	case global_emeralds:
 		lua_pushinteger(L, emeralds);
 		return 1;
-	} else if (fastcmp(word,"gravity")) {
+	case global_gravity:
 		lua_pushinteger(L, gravity);
 		return 1;
-	} else if (fastcmp(word,"VERSION")) {
+	case global_VERSION:
 		lua_pushinteger(L, VERSION);
 		return 1;
-	} else if (fastcmp(word,"SUBVERSION")) {
+	case global_SUBVERSION:
 		lua_pushinteger(L, SUBVERSION);
 		return 1;
-	} else if (fastcmp(word,"VERSIONSTRING")) {
+	case global_VERSIONSTRING:
 		lua_pushstring(L, VERSIONSTRING);
 		return 1;
-	} else if (fastcmp(word, "token")) {
+	case global_token:
 		lua_pushinteger(L, token);
 		return 1;
-	} else if (fastcmp(word, "gamestate")) {
+	case global_gamestate:
 		lua_pushinteger(L, gamestate);
 		return 1;
-	} else if (fastcmp(word, "stagefailed")) {
+	case global_stagefailed:
 		lua_pushboolean(L, stagefailed);
 		return 1;
 	// TODO: 2.3: Deprecated (moved to the input library)
-	} else if (fastcmp(word, "mouse")) {
+	case global_mouse:
 		LUA_PushUserdata(L, &mouse, META_MOUSE);
 		return 1;
 	// TODO: 2.3: Deprecated (moved to the input library)
-	} else if (fastcmp(word, "mouse2")) {
+	case global_mouse2:
 		LUA_PushUserdata(L, &mouse2, META_MOUSE);
 		return 1;
-	} else if (fastcmp(word, "camera")) {
+	case global_camera:
 		LUA_PushUserdata(L, &camera, META_CAMERA);
 		return 1;
-	} else if (fastcmp(word, "camera2")) {
+	case global_camera2:
 		if (!splitscreen)
 			return 0;
 		LUA_PushUserdata(L, &camera2, META_CAMERA);
 		return 1;
-	} else if (fastcmp(word, "chatactive")) {
+	case global_chatactive:
 		lua_pushboolean(L, chat_on);
 		return 1;
+	default:
+		return 0;
 	}
-	return 0;
 }
 
 // See the above.
@@ -546,6 +982,25 @@ static int setglobals(lua_State *L)
 	return luaL_error(L, "Implicit global " LUA_QS " prevented. Create a local variable instead.", csname);
 }
 
+// Userdata field names are looked up on every access, so remember which
+// field each name string resolved to. Lua interns its strings, and every
+// valid field name is kept alive as a key of its field table, so the string
+// pointer alone identifies the name for as long as the state lives. Names
+// that aren't fields are never remembered, since their strings can be
+// collected and the memory reused for a different one.
+#define FIELDCACHESIZE 1024 // must be a power of two
+static struct
+{
+	const char *name;
+	int list_ref;
+	int field;
+} fieldcache[FIELDCACHESIZE];
+
+static void LUA_ClearFieldCache(void)
+{
+	memset(fieldcache, 0, sizeof(fieldcache));
+}
+
 // Clear and create a new Lua state, laddo!
 // There's SCRIPTIN to be had!
 static void LUA_ClearState(void)
@@ -557,11 +1012,13 @@ static void LUA_ClearState(void)
 	if (gL)
 		lua_close(gL);
 	gL = NULL;
+	LUA_PoolClear(&luapool);
+	LUA_ClearFieldCache();
 
 	CONS_Printf(M_GetText("Pardon me while I initialize the Lua scripting interface...\n"));
 
 	// allocate state
-	L = lua_newstate(LUA_Alloc, NULL);
+	L = lua_newstate(LUA_Alloc, &luapool);
 	lua_atpanic(L, LUA_Panic);
 
 	// open base libraries
@@ -789,6 +1246,7 @@ void LUA_DumpFile(const char *filename)
 fixed_t LUA_EvalMath(const char *word)
 {
 	static lua_State *L = NULL;
+	static luapool_t pool; // never closed, so never cleared
 	char buf[1024], *b;
 	const char *p;
 	fixed_t res = 0;
@@ -797,7 +1255,7 @@ fixed_t LUA_EvalMath(const char *word)
 	{
 		// make a new state so SOC can't interefere with scripts
 		// allocate state
-		L = lua_newstate(LUA_Alloc, NULL);
+		L = lua_newstate(LUA_Alloc, &pool);
 		lua_atpanic(L, LUA_Panic);
 
 		// open only enum lib
@@ -1047,6 +1505,9 @@ enum
 	ARCH_MOUSE,
 	ARCH_SKIN,
 
+	ARCH_STRINGREF,
+	ARCH_NUMARRAY,
+
 	ARCH_TEND=0xFF,
 };
 
@@ -1098,6 +1559,126 @@ static UINT8 GetUserdataArchType(int index)
 	return ARCH_NULL;
 }
 
+// Strings at least this long are only written out once per archive,
+// and refer back to the first copy after that.
+#define ARCHIVE_MININTERNED 4
+
+// Tables with nothing but numbers from 1 to n, where n is at least this,
+// have those written as a single block.
+#define ARCHIVE_MINNUMARRAY 8
+
+// Besides the tables themselves, the tables table maps each archived
+// table to its index, and each interned string to its id when archiving,
+// or minus the id to the string when unarchiving.
+static UINT16 archivestrings;
+
+//
+// Archive size accounting, for luaarchivesize
+//
+// Each byte LUA_Archive writes for an extra mobj or player variable is
+// charged to that variable's name, and each byte a NetVars hook writes is
+// charged to the file the hook is in. Tables are charged to whatever
+// referenced them first.
+//
+
+#define ARCHIVE_MAXOWNERS 512
+#define ARCHIVE_OWNERHASHSIZE 1024 // must be a power of two, and at least twice ARCHIVE_MAXOWNERS
+
+typedef struct
+{
+	char name[64];
+	UINT32 hash;
+	size_t bytes;
+} archiveowner_t;
+
+static archiveowner_t archiveowners[ARCHIVE_MAXOWNERS];
+static UINT16 numarchiveowners;
+static UINT16 archiveownerhash[ARCHIVE_OWNERHASHSIZE]; // index into archiveowners plus one
+static UINT16 archiveowner; // who gets charged for what's being written, plus one; 0 for nobody
+static UINT16 *tableowners; // archiveowner of each table, by index
+static size_t maxtableowners;
+static size_t archivesize; // size of the last archive
+
+static UINT16 LUA_ArchiveOwner(const char *a, const char *b, const char *c)
+{
+	char label[64];
+	UINT32 hash = 2166136261u; // FNV-1a
+	const char *p;
+	UINT16 slot;
+
+	snprintf(label, sizeof label, "%s%s%s", a, b, c);
+	for (p = label; *p; p++)
+		hash = (hash ^ (UINT8)*p) * 16777619u;
+
+	for (slot = hash & (ARCHIVE_OWNERHASHSIZE - 1); archiveownerhash[slot]; slot = (slot + 1) & (ARCHIVE_OWNERHASHSIZE - 1))
+	{
+		const archiveowner_t *o = &archiveowners[archiveownerhash[slot] - 1];
+		if (o->hash == hash && !strcmp(o->name, label))
+			return archiveownerhash[slot];
+	}
+
+	// The last one takes in everything that doesn't fit anymore
+	if (numarchiveowners == ARCHIVE_MAXOWNERS)
+		return ARCHIVE_MAXOWNERS;
+	if (numarchiveowners == ARCHIVE_MAXOWNERS - 1)
+		strlcpy(label, "(everything else)", sizeof label);
+
+	strlcpy(archiveowners[numarchiveowners].name, label, sizeof archiveowners[numarchiveowners].name);
+	archiveowners[numarchiveowners].hash = hash;
+	archiveowners[numarchiveowners].bytes = 0;
+	archiveownerhash[slot] = ++numarchiveowners;
+	return numarchiveowners;
+}
+
+static void LUA_ChargeArchive(UINT16 owner, size_t bytes)
+{
+	if (owner)
+		archiveowners[owner - 1].bytes += bytes;
+}
+
+static void LUA_SetTableOwner(UINT16 t)
+{
+	if (t >= maxtableowners)
+	{
+		maxtableowners = max((size_t)t + 1, maxtableowners * 2);
+		tableowners = Z_Realloc(tableowners, maxtableowners * sizeof (*tableowners), PU_STATIC, NULL);
+	}
+	tableowners[t] = archiveowner;
+}
+
+static int LUA_CompareArchiveOwners(const void *a, const void *b)
+{
+	const size_t sa = archiveowners[*(const UINT16 *)a].bytes;
+	const size_t sb = archiveowners[*(const UINT16 *)b].bytes;
+	return (sa < sb) - (sa > sb);
+}
+
+void Command_LuaArchiveSize_f(void)
+{
+	UINT16 order[ARCHIVE_MAXOWNERS];
+	INT32 count = (COM_Argc() > 1) ? atoi(COM_Argv(1)) : 20;
+	size_t charged = 0;
+	INT32 i;
+
+	for (i = 0; i < numarchiveowners; i++)
+	{
+		order[i] = (UINT16)i;
+		charged += archiveowners[i].bytes;
+	}
+	qsort(order, numarchiveowners, sizeof (*order), LUA_CompareArchiveOwners);
+
+	CONS_Printf(M_GetText("The last Lua archive was %s bytes:\n"), sizeu1(archivesize));
+	for (i = 0; i < min(count, numarchiveowners); i++)
+	{
+		const archiveowner_t *o = &archiveowners[order[i]];
+		CONS_Printf("%10s %5.1f%%  %s\n", sizeu1(o->bytes),
+			archivesize ? 100.0 * o->bytes / archivesize : 0.0, o->name);
+	}
+	CONS_Printf("%10s %5.1f%%  %s\n", sizeu1(archivesize - charged),
+		archivesize ? 100.0 * (archivesize - charged) / archivesize : 0.0,
+		M_GetText("(headers and markers)"));
+}
+
 static UINT8 ArchiveValue(save_t *save_p, int TABLESINDEX, int myindex)
 {
 	if (myindex < 0)
@@ -1141,7 +1722,28 @@ static UINT8 ArchiveValue(save_t *save_p, int TABLESINDEX, int myindex)
 	{
 		UINT32 len = (UINT32)lua_objlen(gL, myindex); // get length of string, including embedded zeros
 		const char *s = lua_tostring(gL, myindex);
-		UINT32 i = 0;
+
+		if (len >= ARCHIVE_MININTERNED)
+		{
+			lua_pushvalue(gL, myindex);
+			lua_rawget(gL, TABLESINDEX);
+			if (lua_isnumber(gL, -1))
+			{
+				P_WriteUINT8(save_p, ARCH_STRINGREF);
+				P_WriteUINT16(save_p, (UINT16)lua_tointeger(gL, -1));
+				lua_pop(gL, 1);
+				break;
+			}
+			lua_pop(gL, 1);
+
+			if (archivestrings < UINT16_MAX)
+			{
+				lua_pushvalue(gL, myindex);
+				lua_pushinteger(gL, ++archivestrings);
+				lua_rawset(gL, TABLESINDEX);
+			}
+		}
+
 		// if you're wondering why we're writing a string to save_p this way,
 		// it turns out that Lua can have embedded zeros ('\0') in the strings,
 		// so we can't use P_WriteString as that cuts off when it finds a '\0'.
@@ -1159,48 +1761,45 @@ static UINT8 ArchiveValue(save_t *save_p, int TABLESINDEX, int myindex)
 			P_WriteUINT8(save_p, ARCH_LARGESTRING);
 			P_WriteUINT32(save_p, len); // save size of string
 		}
-		while (i < len)
-			P_WriteChar(save_p, s[i++]); // write chars individually, including the embedded zeros
+		P_WriteMem(save_p, s, len); // including the embedded zeros
 		break;
 	}
 	case LUA_TTABLE:
 	{
-		boolean found = false;
-		INT32 i;
-		UINT16 t = (UINT16)lua_objlen(gL, TABLESINDEX);
+		UINT16 t;
+
+		// Look the table up in the tables table, instead of going through
+		// every table archived so far
+		lua_pushvalue(gL, myindex);
+		lua_rawget(gL, TABLESINDEX);
+		t = (UINT16)lua_tointeger(gL, -1);
+		lua_pop(gL, 1);
 
-		for (i = 1; i <= t && !found; i++)
+		if (t)
 		{
-			lua_rawgeti(gL, TABLESINDEX, i);
-			if (lua_rawequal(gL, myindex, -1))
-			{
-				t = i;
-				found = true;
-			}
-			lua_pop(gL, 1);
+			P_WriteUINT8(save_p, ARCH_TABLE);
+			P_WriteUINT16(save_p, t);
+			break;
 		}
-		if (!found)
-		{
-			t++;
 
-			if (t == 0)
-			{
-				CONS_Alert(CONS_ERROR, "Too many tables to archive!\n");
-				P_WriteUINT8(save_p, ARCH_NULL);
-				return 0;
-			}
+		t = (UINT16)(lua_objlen(gL, TABLESINDEX) + 1);
+		if (t == 0)
+		{
+			CONS_Alert(CONS_ERROR, "Too many tables to archive!\n");
+			P_WriteUINT8(save_p, ARCH_NULL);
+			return 0;
 		}
 
 		P_WriteUINT8(save_p, ARCH_TABLE);
 		P_WriteUINT16(save_p, t);
 
-		if (!found)
-		{
-			lua_pushvalue(gL, myindex);
-			lua_rawseti(gL, TABLESINDEX, t);
-			return 1;
-		}
-		break;
+		lua_pushvalue(gL, myindex);
+		lua_rawseti(gL, TABLESINDEX, t);
+		lua_pushvalue(gL, myindex);
+		lua_pushinteger(gL, t);
+		lua_rawset(gL, TABLESINDEX);
+		LUA_SetTableOwner(t);
+		return 1;
 	}
 	case LUA_TUSERDATA:
 		switch (GetUserdataArchType(myindex))
@@ -1458,12 +2057,17 @@ static void ArchiveExtVars(save_t *save_p, void *pointer, const char *ptype)
 	lua_pushnil(gL);
 	while (lua_next(gL, -2))
 	{
+		const size_t start = save_p->pos;
+
 		I_Assert(lua_type(gL, -2) == LUA_TSTRING);
-		P_WriteString(save_p, lua_tostring(gL, -2));
+		archiveowner = LUA_ArchiveOwner(ptype, ".", lua_tostring(gL, -2));
+		ArchiveValue(save_p, TABLESINDEX, -2); // the same names come up over and over, so they're interned too
 		if (ArchiveValue(save_p, TABLESINDEX, -1) == 2)
 			CONS_Alert(CONS_ERROR, "Type of value for %s entry '%s' (%s) could not be archived!\n", ptype, lua_tostring(gL, -2), luaL_typename(gL, -1));
+		LUA_ChargeArchive(archiveowner, save_p->pos - start);
 		lua_pop(gL, 1);
 	}
+	archiveowner = 0;
 
 	lua_pop(gL, 1);
 }
@@ -1471,12 +2075,84 @@ static void ArchiveExtVars(save_t *save_p, void *pointer, const char *ptype)
 // FIXME: remove and pass as local variable
 static save_t *lua_save_p;
 
+// Finds who to charge for what a NetVars hook writes.
+static UINT16 LUA_NetVarsOwner(lua_State *L)
+{
+	lua_Debug ar;
+	int level = 0;
+
+	// The hook itself is the outermost function running
+	while (lua_getstack(L, level + 1, &ar))
+		level++;
+	if (lua_getstack(L, level, &ar) && lua_getinfo(L, "S", &ar))
+		return LUA_ArchiveOwner("NetVars", " ", ar.short_src);
+	return LUA_ArchiveOwner("NetVars", "", "");
+}
+
 static int NetArchive(lua_State *L)
 {
 	int TABLESINDEX = lua_upvalueindex(1);
 	int i, n = lua_gettop(L);
+	const size_t start = lua_save_p->pos;
+
+	archiveowner = LUA_NetVarsOwner(L);
 	for (i = 1; i <= n; i++)
 		ArchiveValue(lua_save_p, TABLESINDEX, i);
+	LUA_ChargeArchive(archiveowner, lua_save_p->pos - start);
+	archiveowner = 0;
+	return n;
+}
+
+// Writes the entries from 1 to n of the table on top of the stack as one
+// block, if there are enough of them and they're all numbers.
+// Returns n if it did, 0 otherwise.
+static size_t ArchiveNumArray(save_t *save_p)
+{
+	const size_t n = lua_objlen(gL, -1);
+	lua_Integer lo = 0, hi = 0;
+	UINT8 width;
+	size_t j;
+
+	if (n < ARCHIVE_MINNUMARRAY)
+		return 0;
+
+	for (j = 1; j <= n; j++)
+	{
+		lua_Integer number;
+
+		lua_rawgeti(gL, -1, (int)j);
+		if (lua_type(gL, -1) != LUA_TNUMBER)
+		{
+			lua_pop(gL, 1);
+			return 0;
+		}
+		number = lua_tointeger(gL, -1);
+		lo = min(lo, number);
+		hi = max(hi, number);
+		lua_pop(gL, 1);
+	}
+
+	if (lo >= INT8_MIN && hi <= INT8_MAX)
+		width = 1;
+	else if (lo >= INT16_MIN && hi <= INT16_MAX)
+		width = 2;
+	else
+		width = 4;
+
+	P_WriteUINT8(save_p, ARCH_NUMARRAY);
+	P_WriteUINT32(save_p, (UINT32)n);
+	P_WriteUINT8(save_p, width);
+	for (j = 1; j <= n; j++)
+	{
+		lua_rawgeti(gL, -1, (int)j);
+		if (width == 1)
+			P_WriteSINT8(save_p, (SINT8)lua_tointeger(gL, -1));
+		else if (width == 2)
+			P_WriteINT16(save_p, (INT16)lua_tointeger(gL, -1));
+		else
+			P_WriteFixed(save_p, (fixed_t)lua_tointeger(gL, -1));
+		lua_pop(gL, 1);
+	}
 	return n;
 }
 
@@ -1485,6 +2161,7 @@ static void ArchiveTables(save_t *save_p)
 	int TABLESINDEX;
 	UINT16 i, n;
 	UINT8 e;
+	size_t packed, start;
 
 	if (!gL)
 		return;
@@ -1494,10 +2171,25 @@ static void ArchiveTables(save_t *save_p)
 	n = (UINT16)lua_objlen(gL, TABLESINDEX);
 	for (i = 1; i <= n; i++)
 	{
+		start = save_p->pos;
+		archiveowner = tableowners[i];
+
 		lua_rawgeti(gL, TABLESINDEX, i);
+		packed = ArchiveNumArray(save_p);
 		lua_pushnil(gL);
 		while (lua_next(gL, -2))
 		{
+			// Skip what ArchiveNumArray already wrote
+			if (packed && lua_type(gL, -2) == LUA_TNUMBER)
+			{
+				lua_Integer k = lua_tointeger(gL, -2);
+				if (k >= 1 && (size_t)k <= packed)
+				{
+					lua_pop(gL, 1);
+					continue;
+				}
+			}
+
 			// Write key
 			e = ArchiveValue(save_p, TABLESINDEX, -2); // key should be either a number or a string, ArchiveValue can handle this.
 			if (e == 1)
@@ -1530,7 +2222,23 @@ static void ArchiveTables(save_t *save_p)
 			P_WriteUINT16(save_p, 0);
 
 		lua_pop(gL, 1);
+
+		LUA_ChargeArchive(archiveowner, save_p->pos - start);
 	}
+	archiveowner = 0;
+}
+
+// Mobjs by mobjnum while LUA_UnArchive runs
+static mobj_t **unarchivemobjs;
+static UINT32 numunarchivemobjs;
+
+static mobj_t *LUA_FindUnArchivedMobj(UINT32 mobjnum)
+{
+	if (!unarchivemobjs)
+		return P_FindNewPosition(mobjnum);
+	if (mobjnum >= numunarchivemobjs || !unarchivemobjs[mobjnum] || P_MobjWasRemoved(unarchivemobjs[mobjnum]))
+		return NULL;
+	return unarchivemobjs[mobjnum];
 }
 
 static UINT8 UnArchiveValue(save_t *save_p, int TABLESINDEX)
@@ -1577,8 +2285,43 @@ static UINT8 UnArchiveValue(save_t *save_p, int TABLESINDEX)
 			value[i++] = P_ReadChar(save_p); // read chars individually, including the embedded zeros
 		lua_pushlstring(gL, value, len); // push the string (note: this function supports embedded zeros)
 		free(value); // free the buffer
+
+		// Number it the same way ArchiveValue did
+		if (len >= ARCHIVE_MININTERNED && archivestrings < UINT16_MAX)
+		{
+			lua_pushvalue(gL, -1);
+			lua_rawseti(gL, TABLESINDEX, -(int)++archivestrings);
+		}
 		break;
 	}
+	case ARCH_STRINGREF:
+		lua_rawgeti(gL, TABLESINDEX, -(int)P_ReadUINT16(save_p));
+		break;
+	case ARCH_NUMARRAY:
+	{
+		// Only ever at the start of a table, which is on top of the stack
+		UINT32 len = P_ReadUINT32(save_p);
+		UINT8 width = P_ReadUINT8(save_p);
+		UINT32 j;
+
+		if ((width != 1 && width != 2 && width != 4) || len > (save_p->size - save_p->pos) / width)
+		{
+			CONS_Alert(CONS_ERROR, "Corrupted Lua number array!\n");
+			return 3;
+		}
+
+		for (j = 1; j <= len; j++)
+		{
+			if (width == 1)
+				lua_pushinteger(gL, P_ReadSINT8(save_p));
+			else if (width == 2)
+				lua_pushinteger(gL, P_ReadINT16(save_p));
+			else
+				lua_pushinteger(gL, P_ReadFixed(save_p));
+			lua_rawseti(gL, -2, (int)j);
+		}
+		return 3;
+	}
 	case ARCH_TABLE:
 	{
 		UINT16 tid = P_ReadUINT16(save_p);
@@ -1600,7 +2343,7 @@ static UINT8 UnArchiveValue(save_t *save_p, int TABLESINDEX)
 		LUA_PushUserdata(gL, &states[P_ReadUINT16(save_p)], META_STATE);
 		break;
 	case ARCH_MOBJ:
-		LUA_PushUserdata(gL, P_FindNewPosition(P_ReadUINT32(save_p)), META_MOBJ);
+		LUA_PushUserdata(gL, LUA_FindUnArchivedMobj(P_ReadUINT32(save_p)), META_MOBJ);
 		break;
 	case ARCH_PLAYER:
 		LUA_PushUserdata(gL, &players[P_ReadUINT8(save_p)], META_PLAYER);
@@ -1669,7 +2412,6 @@ static void UnArchiveExtVars(save_t *save_p, void *pointer)
 	int TABLESINDEX;
 	UINT16 field_count = P_ReadUINT16(save_p);
 	UINT16 i;
-	char field[1024];
 
 	if (field_count == 0)
 		return;
@@ -1680,9 +2422,21 @@ static void UnArchiveExtVars(save_t *save_p, void *pointer)
 
 	for (i = 0; i < field_count; i++)
 	{
-		P_ReadString(save_p, field);
-		UnArchiveValue(save_p, TABLESINDEX);
-		lua_setfield(gL, -2, field);
+		UnArchiveValue(save_p, TABLESINDEX); // read key
+		UnArchiveValue(save_p, TABLESINDEX); // read value
+		if (lua_type(gL, -2) != LUA_TSTRING)
+		{
+			CONS_Alert(CONS_ERROR, "A non-string extra variable name was found! (Corrupted save?)\n");
+			lua_pop(gL, 2);
+		}
+		else
+			lua_rawset(gL, -3);
+	}
+
+	if (!pointer) // the mobj is gone, so the variables only had to be read past
+	{
+		lua_pop(gL, 1);
+		return;
 	}
 
 	lua_getfield(gL, LUA_REGISTRYINDEX, LREG_EXTVARS);
@@ -1724,6 +2478,8 @@ static void UnArchiveTables(save_t *save_p)
 				break;
 			else if (e == 2) // Key contains a new table
 				n++;
+			else if (e == 3) // Numbers were put in the table directly
+				continue;
 
 			if (UnArchiveValue(save_p, TABLESINDEX) == 2) // read value
 				n++;
@@ -1753,22 +2509,94 @@ static void UnArchiveTables(save_t *save_p)
 	}
 }
 
-void LUA_Step(void)
+//
+// Lua GC scheduling (cv_luagcscheduler)
+//
+// By default the collector takes one small step per frame and otherwise
+// runs whenever Lua's own allocation thresholds say so, which is usually
+// in the middle of some hook. With the scheduler on, Lua's automatic
+// collection is kept stopped, and each frame the collector gets a step
+// sized to how much the heap grew since the last one, plus as many small
+// steps as fit into half of the time the frame would otherwise spend
+// sleeping. Should the heap still get out of hand, automatic collection
+// is let back on until the scheduler catches up.
+//
+
+consvar_t cv_luagcscheduler = CVAR_INIT ("luagcscheduler", "Off", CV_SAVE, CV_OnOff, NULL);
+
+#define LUAGC_IDLESTEP 16 // KB per step while filling idle time
+#define LUAGC_MINHEAP 4096 // KB; don't bother with emergencies below this
+
+static INT32 luagclastkb = 0; // heap size after the last step
+static INT32 luagccyclekb = 0; // heap size when the last cycle finished
+static boolean luagcstopped = false;
+
+void LUA_Step(precise_t idle)
 {
+	precise_t start;
+	INT32 kb, stepkb;
+	boolean finished;
+
 	if (!gL)
 		return;
 	lua_settop(gL, 0);
-	lua_gc(gL, LUA_GCSTEP, 1);
+
+	if (!cv_luagcscheduler.value)
+	{
+		if (luagcstopped)
+		{
+			lua_gc(gL, LUA_GCRESTART, 0);
+			luagcstopped = false;
+		}
+
+		PS_START_TIMING(ps_lua_gctime);
+		lua_gc(gL, LUA_GCSTEP, 1);
+		PS_STOP_TIMING(ps_lua_gctime);
+		ps_lua_heapkb.value.i = lua_gc(gL, LUA_GCCOUNT, 0);
+		return;
+	}
+
+	start = I_GetPreciseTime();
+	kb = lua_gc(gL, LUA_GCCOUNT, 0);
+
+	// Do twice the work that was allocated, to stay ahead of the garbage
+	stepkb = max(1, (kb - luagclastkb) * 2);
+	finished = lua_gc(gL, LUA_GCSTEP, stepkb);
+
+	while (!finished && I_GetPreciseTime() - start < idle / 2)
+		finished = lua_gc(gL, LUA_GCSTEP, LUAGC_IDLESTEP);
+
+	kb = lua_gc(gL, LUA_GCCOUNT, 0);
+	if (finished)
+		luagccyclekb = kb;
+	luagclastkb = kb;
+
+	// Stepping sets Lua's thresholds again, so stop it from collecting on
+	// its own, unless the heap has more than doubled since the last cycle.
+	if (kb < max(LUAGC_MINHEAP, luagccyclekb * 2))
+		lua_gc(gL, LUA_GCSTOP, 0);
+	else
+		lua_gc(gL, LUA_GCRESTART, 0);
+	luagcstopped = true;
+
+	ps_lua_gctime.value.p = I_GetPreciseTime() - start;
+	ps_lua_heapkb.value.i = kb;
 }
 
 void LUA_Archive(save_t *save_p)
 {
 	INT32 i;
 	thinker_t *th;
+	const size_t start = save_p->pos;
 
 	if (gL)
 		lua_newtable(gL); // tables to be archived.
 
+	archivestrings = 0;
+	archiveowner = 0;
+	numarchiveowners = 0;
+	memset(archiveownerhash, 0, sizeof archiveownerhash);
+
 	for (i = 0; i < MAXPLAYERS; i++)
 	{
 		if (!playeringame[i] && i > 0) // dedicated servers...
@@ -1795,6 +2623,8 @@ void LUA_Archive(save_t *save_p)
 
 	if (gL)
 		lua_pop(gL, 1); // pop tables
+
+	archivesize = save_p->pos - start;
 }
 
 void LUA_UnArchive(save_t *save_p)
@@ -1806,6 +2636,22 @@ void LUA_UnArchive(save_t *save_p)
 	if (gL)
 		lua_newtable(gL); // tables to be read
 
+	archivestrings = 0;
+
+	// Index the mobjs by mobjnum, instead of going through all of them
+	// for every mobj with variables and every mobj reference
+	numunarchivemobjs = 0;
+	for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
+		if (!th->removing)
+			numunarchivemobjs = max(numunarchivemobjs, ((mobj_t *)th)->mobjnum + 1);
+	if (numunarchivemobjs)
+	{
+		unarchivemobjs = Z_Calloc(numunarchivemobjs * sizeof (*unarchivemobjs), PU_STATIC, NULL);
+		for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
+			if (!th->removing)
+				unarchivemobjs[((mobj_t *)th)->mobjnum] = (mobj_t *)th;
+	}
+
 	for (i = 0; i < MAXPLAYERS; i++)
 	{
 		if (!playeringame[i] && i > 0) // dedicated servers...
@@ -1813,17 +2659,8 @@ void LUA_UnArchive(save_t *save_p)
 		UnArchiveExtVars(save_p, &players[i]);
 	}
 
-	do {
-		mobjnum = P_ReadUINT32(save_p); // read a mobjnum
-		for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
-		{
-			if (th->removing)
-				continue;
-			if (((mobj_t *)th)->mobjnum != mobjnum) // find matching mobj
-				continue;
-			UnArchiveExtVars(save_p, th); // apply variables
-		}
-	} while(mobjnum != UINT32_MAX); // repeat until end of mobjs marker.
+	while ((mobjnum = P_ReadUINT32(save_p)) != UINT32_MAX) // repeat until end of mobjs marker.
+		UnArchiveExtVars(save_p, LUA_FindUnArchivedMobj(mobjnum)); // apply variables
 
 	lua_save_p = save_p;
 	LUA_HookNetArchive(NetUnArchive); // call the NetArchive hook in unarchive mode
@@ -1831,16 +2668,28 @@ void LUA_UnArchive(save_t *save_p)
 
 	if (gL)
 		lua_pop(gL, 1); // pop tables
+
+	if (unarchivemobjs)
+		Z_Free(unarchivemobjs);
+	unarchivemobjs = NULL;
+	numunarchivemobjs = 0;
 }
 
 // For mobj_t, player_t, etc. to take custom variables.
 int Lua_optoption(lua_State *L, int narg, int def, int list_ref)
 {
+	const char *name;
+	size_t slot;
+
 	if (lua_isnoneornil(L, narg))
 		return def;
 
 	I_Assert(lua_checkstack(L, 2));
-	luaL_checkstring(L, narg);
+	name = luaL_checkstring(L, narg);
+
+	slot = (((size_t)name >> 4) ^ (size_t)list_ref) & (FIELDCACHESIZE - 1);
+	if (fieldcache[slot].name == name && fieldcache[slot].list_ref == list_ref)
+		return fieldcache[slot].field;
 
 	lua_rawgeti(L, LUA_REGISTRYINDEX, list_ref);
 	I_Assert(lua_istable(L, -1));
@@ -1848,7 +2697,12 @@ int Lua_optoption(lua_State *L, int narg, int def, int list_ref)
 	lua_rawget(L, -2);
 
 	if (lua_isnumber(L, -1))
-		return lua_tointeger(L, -1);
+	{
+		fieldcache[slot].name = name;
+		fieldcache[slot].list_ref = list_ref;
+		fieldcache[slot].field = lua_tointeger(L, -1);
+		return fieldcache[slot].field;
+	}
 	return -1;
 }
 
@@ -51,10 +51,14 @@ void LUA_DoLump(UINT16 wad, UINT16 lump, boolean noresults);
 #ifdef LUA_ALLOW_BYTECODE
 void LUA_DumpFile(const char *filename);
 #endif
+#ifdef DEVELOP
+void Command_LuaAllocBench_f(void);
+#endif
 fixed_t LUA_EvalMath(const char *word);
-void LUA_Step(void);
+void LUA_Step(precise_t idle);
 void LUA_Archive(save_t *save_p);
 void LUA_UnArchive(save_t *save_p);
+void Command_LuaArchiveSize_f(void);
 int LUA_PushGlobals(lua_State *L, const char *word);
 int LUA_CheckGlobals(lua_State *L, const char *word);
 void Got_Luacmd(UINT8 **cp, INT32 playernum); // lua_consolelib.c
@@ -63,6 +67,9 @@ int Lua_optoption(lua_State *L, int narg, int def, int list_ref);
 int Lua_CreateFieldTable(lua_State *L, const char *const lst[]);
 void LUA_HookNetArchive(lua_CFunction archFunc);
 
+void LUA_RunTasks(void); // lua_tasklib.c
+INT32 LUA_NumTasks(void); // lua_tasklib.c
+
 void LUA_PushTaggableObjectArray
 (		lua_State *L,
 		const char *field,
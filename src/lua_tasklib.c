@@ -0,0 +1,285 @@
+// SONIC ROBO BLAST 2
+//-----------------------------------------------------------------------------
+// Copyright (C) 2024 by Sonic Team Junior.
+//
+// This program is free software distributed under the
+// terms of the GNU General Public License, version 2.
+// See the 'LICENSE' file for more details.
+//-----------------------------------------------------------------------------
+/// \file  lua_tasklib.c
+/// \brief Lua tasks, coroutines resumed by the engine every tic
+
+#include "doomdef.h"
+#include "command.h"
+#include "m_perfstats.h"
+#include "netcode/d_clisrv.h"
+#include "lua_script.h"
+#include "lua_libs.h"
+#include "lua_hud.h" // hud_running errors
+#include "lua_hook.h" // hook_cmd_running errors
+
+#define NOHUD if (hud_running)\
+return luaL_error(L, "HUD rendering code should not call this function!");\
+else if (hook_cmd_running)\
+return luaL_error(L, "CMD building code should not call this function!");
+
+//
+// A task is a coroutine that the engine resumes once per tic, right after
+// the ThinkFrame hooks, so work that doesn't fit in a single tic can be
+// spread over several instead of stalling the game.
+//
+// Tasks are resumed in the order they were added. Each one gets an equal
+// share of cv_luataskbudget, counted in Lua VM instructions; once it has
+// used its share it is suspended where it stands and picked up again next
+// tic. Instructions are counted the same way on every machine, unlike
+// time, so every client suspends a task at the same point and gets the
+// same results. A task can also give up the rest of its share early by
+// calling coroutine.yield().
+//
+// A task can only be suspended in its own Lua code, not inside a function
+// called from C (searchBlockmap callbacks, metamethods, pcall and so on),
+// so it may run over its share until it gets back to its own code.
+//
+// Coroutines can't be archived, so tasks are not sent to players joining
+// a netgame, and the server warns when it sends the game while tasks are
+// running. Anything a task produces that must stay in sync should be kept
+// somewhere NetVars archives, and the task restarted from there.
+//
+
+static CV_PossibleValue_t luataskbudget_cons_t[] = {{1000, "MIN"}, {10000000, "MAX"}, {0, NULL}};
+consvar_t cv_luataskbudget = CVAR_INIT ("luataskbudget", "200000", CV_SAVE|CV_NETVAR, luataskbudget_cons_t, NULL);
+
+// Instructions between checks while a task that ran out of budget is
+// inside a C call and can't be suspended yet.
+#define TASK_RETRYCOUNT 100
+
+static lua_State *runningtask = NULL; // task being resumed by LUA_RunTasks
+
+// Count hook set on a task while it runs.
+static void TaskHook(lua_State *L, lua_Debug *ar)
+{
+	(void)ar;
+
+	// Coroutines created by the task inherit this hook,
+	// but they only answer to whoever resumes them.
+	if (L != runningtask)
+		return;
+
+	if (lua_isyieldable(L))
+		lua_yield(L, 0);
+	else
+		lua_sethook(L, TaskHook, LUA_MASKCOUNT, TASK_RETRYCOUNT);
+}
+
+// Call hook set on a task until it is first resumed. A task that still
+// has it hasn't started yet; one that has neither it nor a pending yield
+// has finished, even if a mod resumed it to the end by hand.
+static void TaskStartHook(lua_State *L, lua_Debug *ar)
+{
+	(void)ar;
+	lua_sethook(L, NULL, 0, 0);
+}
+
+// Pushes the task list, creating it if needed.
+static void GetTaskList(lua_State *L)
+{
+	lua_getfield(L, LUA_REGISTRYINDEX, LREG_TASKS);
+	if (!lua_istable(L, -1))
+	{
+		lua_pop(L, 1);
+		lua_newtable(L);
+		lua_pushvalue(L, -1);
+		lua_setfield(L, LUA_REGISTRYINDEX, LREG_TASKS);
+	}
+}
+
+// addTask(function, ...)
+// Adds a task that calls function with the given arguments.
+// Returns the task's coroutine.
+static int lib_addTask(lua_State *L)
+{
+	int nargs = lua_gettop(L) - 1;
+	lua_State *co;
+
+	luaL_checktype(L, 1, LUA_TFUNCTION);
+	NOHUD
+
+	GetTaskList(L);
+	co = lua_newthread(L);
+	lua_pushvalue(L, -1);
+	lua_rawseti(L, -3, (int)lua_objlen(L, -3) + 1);
+
+	// function and arguments, ready for the first resume
+	lua_pushvalue(L, 1);
+	lua_xmove(L, co, 1);
+	if (nargs > 0)
+	{
+		int i;
+		for (i = 2; i <= nargs + 1; i++)
+			lua_pushvalue(L, i);
+		lua_xmove(L, co, nargs);
+	}
+
+	lua_sethook(co, TaskStartHook, LUA_MASKCALL, 0);
+
+	return 1;
+}
+
+// cancelTask(task)
+// Stops a task from being resumed again. A task can cancel itself,
+// in which case it stops the next time it yields.
+// Returns false if the task was not running.
+static int lib_cancelTask(lua_State *L)
+{
+	lua_State *co;
+	int i, n;
+
+	luaL_checktype(L, 1, LUA_TTHREAD);
+	NOHUD
+	co = lua_tothread(L, 1);
+
+	GetTaskList(L);
+	n = (int)lua_objlen(L, -1);
+	for (i = 1; i <= n; i++)
+	{
+		lua_rawgeti(L, -1, i);
+		if (lua_tothread(L, -1) == co)
+		{
+			lua_pop(L, 1);
+			lua_pushboolean(L, false);
+			lua_rawseti(L, -2, i);
+			lua_pushboolean(L, true);
+			return 1;
+		}
+		lua_pop(L, 1);
+	}
+
+	lua_pushboolean(L, false);
+	return 1;
+}
+
+// Resumes every task once, in the order they were added.
+void LUA_RunTasks(void)
+{
+	int i, j, n, slice;
+
+	ps_lua_taskcount.value.i = 0;
+
+	if (!gL)
+		return;
+
+	lua_getfield(gL, LUA_REGISTRYINDEX, LREG_TASKS);
+	if (!lua_istable(gL, -1) || (n = (int)lua_objlen(gL, -1)) == 0)
+	{
+		lua_pop(gL, 1);
+		return;
+	}
+
+	slice = max(cv_luataskbudget.value / n, TASK_RETRYCOUNT);
+
+	// Tasks added while this runs wait until next tic.
+	for (i = 1; i <= n; i++)
+	{
+		lua_State *co;
+		int nargs, status;
+
+		lua_rawgeti(gL, -1, i);
+		co = lua_tothread(gL, -1);
+		lua_pop(gL, 1); // still referenced by the list
+		if (!co)
+			continue; // cancelled
+
+		if (lua_status(co) == LUA_YIELD)
+		{
+			lua_settop(co, 0); // drop whatever it yielded
+			nargs = 0;
+		}
+		else if (lua_status(co) == 0 && lua_gethook(co) == TaskStartHook)
+			nargs = lua_gettop(co) - 1;
+		else
+		{
+			// finished or failed while someone resumed it by hand
+			lua_settop(co, 0);
+			lua_pushboolean(gL, false);
+			lua_rawseti(gL, -2, i);
+			continue;
+		}
+
+		ps_lua_taskcount.value.i++;
+
+		runningtask = co;
+		lua_sethook(co, TaskHook, LUA_MASKCOUNT, slice);
+		status = lua_resume(co, nargs);
+		lua_sethook(co, NULL, 0, 0);
+		runningtask = NULL;
+
+		if (status == LUA_YIELD)
+			continue;
+
+		if (status != 0)
+		{
+			CONS_Alert(CONS_WARNING, "%s\n", lua_tostring(co, -1));
+			lua_settop(co, 0);
+		}
+
+		lua_pushboolean(gL, false);
+		lua_rawseti(gL, -2, i);
+	}
+
+	// Close the gaps left by finished and cancelled tasks,
+	// keeping the rest in order.
+	n = (int)lua_objlen(gL, -1);
+	for (i = j = 1; i <= n; i++)
+	{
+		lua_rawgeti(gL, -1, i);
+		if (lua_isthread(gL, -1))
+		{
+			if (i != j)
+				lua_rawseti(gL, -2, j);
+			else
+				lua_pop(gL, 1);
+			j++;
+		}
+		else
+			lua_pop(gL, 1);
+	}
+	for (; j <= n; j++)
+	{
+		lua_pushnil(gL);
+		lua_rawseti(gL, -2, j);
+	}
+
+	lua_pop(gL, 1);
+}
+
+// Returns the number of tasks waiting to be resumed.
+INT32 LUA_NumTasks(void)
+{
+	INT32 i, n, count = 0;
+
+	if (!gL)
+		return 0;
+
+	lua_getfield(gL, LUA_REGISTRYINDEX, LREG_TASKS);
+	if (lua_istable(gL, -1))
+	{
+		n = (INT32)lua_objlen(gL, -1);
+		for (i = 1; i <= n; i++)
+		{
+			lua_rawgeti(gL, -1, i);
+			if (lua_isthread(gL, -1))
+				count++;
+			lua_pop(gL, 1);
+		}
+	}
+	lua_pop(gL, 1);
+
+	return count;
+}
+
+int LUA_TaskLib(lua_State *L)
+{
+	lua_register(L, "addTask", lib_addTask);
+	lua_register(L, "cancelTask", lib_cancelTask);
+	return 0;
+}
@@ -64,12 +64,19 @@ static ps_metric_t ps_precipcount = {0};
 static ps_metric_t ps_removecount = {0};
 
 ps_metric_t ps_checkposition_calls = {0};
+ps_metric_t ps_sightcache_hits = {0};
+ps_metric_t ps_sightcache_misses = {0};
 
 ps_metric_t ps_lua_prethinkframe_time = {0};
 ps_metric_t ps_lua_thinkframe_time = {0};
 ps_metric_t ps_lua_postthinkframe_time = {0};
+ps_metric_t ps_lua_tasks_time = {0};
 
 ps_metric_t ps_lua_mobjhooks = {0};
+ps_metric_t ps_lua_taskcount = {0};
+
+ps_metric_t ps_lua_gctime = {0};
+ps_metric_t ps_lua_heapkb = {0};
 
 ps_metric_t ps_otherlogictime = {0};
 
@@ -110,6 +117,7 @@ perfstatrow_t rendertime_rows[] = {
 
 	{"ui     ", "UI render:     ", &ps_uitime, PS_TIME},
 	{"finupdt", "I_FinishUpdate:", &ps_swaptime, PS_TIME},
+	{"luagc  ", "Lua GC:        ", &ps_lua_gctime, PS_TIME},
 	{0}
 };
 
@@ -162,6 +170,7 @@ perfstatrow_t gamelogic_rows[] = {
 	{"  precip ", "  Precipitation:  ", &ps_thlist_times[THINK_PRECIP], PS_TIME|PS_LEVEL},
 	{" lprethinkf", " LUAh_PreThinkFrame:", &ps_lua_prethinkframe_time, PS_TIME|PS_LEVEL},
 	{" lthinkf", " LUAh_ThinkFrame:", &ps_lua_thinkframe_time, PS_TIME|PS_LEVEL},
+	{" ltasks ", " Lua tasks:      ", &ps_lua_tasks_time, PS_TIME|PS_LEVEL},
 	{" lpostthinkf", " LUAh_PostThinkFrame:", &ps_lua_postthinkframe_time, PS_TIME|PS_LEVEL},
 	{" other  ", " Other:          ", &ps_otherlogictime, PS_TIME|PS_LEVEL},
 	{0}
@@ -183,7 +192,11 @@ perfstatrow_t thinkercount_rows[] = {
 
 perfstatrow_t misc_calls_rows[] = {
 	{"lmhook", "Lua mobj hooks: ", &ps_lua_mobjhooks, PS_LEVEL},
+	{"ltasks", "Lua tasks run:  ", &ps_lua_taskcount, PS_LEVEL},
+	{"luaheap", "Lua heap KB:    ", &ps_lua_heapkb, PS_LEVEL},
 	{"chkpos", "P_CheckPosition:", &ps_checkposition_calls, PS_LEVEL},
+	{"sighth", "Sightcache hits:", &ps_sightcache_hits, PS_LEVEL},
+	{"sightm", "Sightcache miss:", &ps_sightcache_misses, PS_LEVEL},
 	{0}
 };
 
@@ -209,79 +222,63 @@ ps_hookinfo_t *postthinkframe_hooks = NULL;
 int postthinkframe_hooks_length = 0;
 int postthinkframe_hooks_capacity = 16;
 
-void PS_SetPreThinkFrameHookInfo(int index, precise_t time_taken, char* short_src)
+ps_hookinfo_t *hud_hooks = NULL;
+int hud_hooks_length = 0;
+int hud_hooks_capacity = 16;
+
+// Records a hook's time in one of the arrays above, growing it as needed.
+// If growonly is false, the array is cut down to end at this hook.
+static void PS_SetHookInfo(ps_hookinfo_t **hooks, int *length, int *capacity,
+	int index, precise_t time_taken, char* short_src, boolean growonly)
 {
-	if (!prethinkframe_hooks)
+	if (!*hooks)
 	{
 		// array needs to be initialized
-		prethinkframe_hooks = Z_Calloc(sizeof(ps_hookinfo_t) * prethinkframe_hooks_capacity, PU_STATIC, NULL);
+		*hooks = Z_Calloc(sizeof(ps_hookinfo_t) * *capacity, PU_STATIC, NULL);
 	}
-	if (index >= prethinkframe_hooks_capacity)
+	while (index >= *capacity)
 	{
 		// array needs more space, realloc with double size
-		int new_capacity = prethinkframe_hooks_capacity * 2;
-		prethinkframe_hooks = Z_Realloc(prethinkframe_hooks,
+		int new_capacity = *capacity * 2;
+		*hooks = Z_Realloc(*hooks,
 			sizeof(ps_hookinfo_t) * new_capacity, PU_STATIC, NULL);
 		// initialize new memory with zeros so the pointers in the structs are null
-		memset(&prethinkframe_hooks[prethinkframe_hooks_capacity], 0,
-			sizeof(ps_hookinfo_t) * prethinkframe_hooks_capacity);
-		prethinkframe_hooks_capacity = new_capacity;
+		memset(&(*hooks)[*capacity], 0,
+			sizeof(ps_hookinfo_t) * *capacity);
+		*capacity = new_capacity;
 	}
-	prethinkframe_hooks[index].time_taken.value.p = time_taken;
-	memcpy(prethinkframe_hooks[index].short_src, short_src, LUA_IDSIZE * sizeof(char));
-	// since the values are set sequentially from begin to end, the last call should leave
-	// the correct value to this variable
-	prethinkframe_hooks_length = index + 1;
+	(*hooks)[index].time_taken.value.p = time_taken;
+	memcpy((*hooks)[index].short_src, short_src, LUA_IDSIZE * sizeof(char));
+	if (!growonly || index >= *length)
+		*length = index + 1;
+}
+
+// since the values are set sequentially from begin to end, the last call
+// for a thinkframe hook type leaves the correct length
+void PS_SetPreThinkFrameHookInfo(int index, precise_t time_taken, char* short_src)
+{
+	PS_SetHookInfo(&prethinkframe_hooks, &prethinkframe_hooks_length,
+		&prethinkframe_hooks_capacity, index, time_taken, short_src, false);
 }
 
 void PS_SetThinkFrameHookInfo(int index, precise_t time_taken, char* short_src)
 {
-	if (!thinkframe_hooks)
-	{
-		// array needs to be initialized
-		thinkframe_hooks = Z_Calloc(sizeof(ps_hookinfo_t) * thinkframe_hooks_capacity, PU_STATIC, NULL);
-	}
-	if (index >= thinkframe_hooks_capacity)
-	{
-		// array needs more space, realloc with double size
-		int new_capacity = thinkframe_hooks_capacity * 2;
-		thinkframe_hooks = Z_Realloc(thinkframe_hooks,
-			sizeof(ps_hookinfo_t) * new_capacity, PU_STATIC, NULL);
-		// initialize new memory with zeros so the pointers in the structs are null
-		memset(&thinkframe_hooks[thinkframe_hooks_capacity], 0,
-			sizeof(ps_hookinfo_t) * thinkframe_hooks_capacity);
-		thinkframe_hooks_capacity = new_capacity;
-	}
-	thinkframe_hooks[index].time_taken.value.p = time_taken;
-	memcpy(thinkframe_hooks[index].short_src, short_src, LUA_IDSIZE * sizeof(char));
-	// since the values are set sequentially from begin to end, the last call should leave
-	// the correct value to this variable
-	thinkframe_hooks_length = index + 1;
+	PS_SetHookInfo(&thinkframe_hooks, &thinkframe_hooks_length,
+		&thinkframe_hooks_capacity, index, time_taken, short_src, false);
 }
 
 void PS_SetPostThinkFrameHookInfo(int index, precise_t time_taken, char* short_src)
 {
-	if (!postthinkframe_hooks)
-	{
-		// array needs to be initialized
-		postthinkframe_hooks = Z_Calloc(sizeof(ps_hookinfo_t) * postthinkframe_hooks_capacity, PU_STATIC, NULL);
-	}
-	if (index >= postthinkframe_hooks_capacity)
-	{
-		// array needs more space, realloc with double size
-		int new_capacity = postthinkframe_hooks_capacity * 2;
-		postthinkframe_hooks = Z_Realloc(postthinkframe_hooks,
-			sizeof(ps_hookinfo_t) * new_capacity, PU_STATIC, NULL);
-		// initialize new memory with zeros so the pointers in the structs are null
-		memset(&postthinkframe_hooks[postthinkframe_hooks_capacity], 0,
-			sizeof(ps_hookinfo_t) * postthinkframe_hooks_capacity);
-		postthinkframe_hooks_capacity = new_capacity;
-	}
-	postthinkframe_hooks[index].time_taken.value.p = time_taken;
-	memcpy(postthinkframe_hooks[index].short_src, short_src, LUA_IDSIZE * sizeof(char));
-	// since the values are set sequentially from begin to end, the last call should leave
-	// the correct value to this variable
-	postthinkframe_hooks_length = index + 1;
+	PS_SetHookInfo(&postthinkframe_hooks, &postthinkframe_hooks_length,
+		&postthinkframe_hooks_capacity, index, time_taken, short_src, false);
+}
+
+// unlike the thinkframe hooks, HUD hooks of different types get called
+// at different times, so only ever grow the length
+void PS_SetHUDHookInfo(int index, precise_t time_taken, char* short_src)
+{
+	PS_SetHookInfo(&hud_hooks, &hud_hooks_length,
+		&hud_hooks_capacity, index, time_taken, short_src, true);
 }
 
 static boolean PS_HighResolution(void)
@@ -629,6 +626,7 @@ void PS_UpdateTickStats(void)
 				ps_thinkertime.value.p -
 				ps_lua_prethinkframe_time.value.p -
 				ps_lua_thinkframe_time.value.p -
+				ps_lua_tasks_time.value.p -
 				ps_lua_postthinkframe_time.value.p;
 
 			PS_CountThinkers();
@@ -662,6 +660,12 @@ void PS_UpdateTickStats(void)
 					PS_UpdateMetricHistory(&postthinkframe_hooks[i].time_taken, true, false);
 			}
 		}
+		if (cv_perfstats.value == 6) // HUD hooks run outside of levels too
+		{
+			int i;
+			for (i = 0; i < hud_hooks_length; i++)
+				PS_UpdateMetricHistory(&hud_hooks[i].time_taken, true, false);
+		}
 		if (cv_perfstats.value)
 		{
 			ps_tick_index++;
@@ -874,6 +878,11 @@ static void PS_DrawPostThinkFrameStats(void)
 	draw_think_frame_stats(postthinkframe_hooks_length, postthinkframe_hooks);
 }
 
+static void PS_DrawHUDStats(void)
+{
+	draw_think_frame_stats(hud_hooks_length, hud_hooks);
+}
+
 void M_DrawPerfStats(void)
 {
 	if (cv_perfstats.value == 1) // rendering
@@ -889,7 +898,7 @@ void M_DrawPerfStats(void)
 	}
 	else if (cv_perfstats.value >= 3) // lua thinkframe
 	{
-		if (!PS_IsLevelActive())
+		if (!PS_IsLevelActive() && cv_perfstats.value != 6)
 			return;
 		if (!PS_HighResolution())
 		{
@@ -912,6 +921,10 @@ void M_DrawPerfStats(void)
 		{
 			PS_DrawPostThinkFrameStats();
 		}
+		else if (cv_perfstats.value == 6)
+		{
+			PS_DrawHUDStats();
+		}
 	}
 }
 
@@ -926,6 +939,10 @@ static void PS_ClearHistory(void)
 	{
 		thinkframe_hooks[i].time_taken.history = NULL;
 	}
+	for (i = 0; i < hud_hooks_length; i++)
+	{
+		hud_hooks[i].time_taken.history = NULL;
+	}
 
 	ps_frame_index = ps_tick_index = 0;
 	// PS_UpdateMetricHistory will set these correctly when it runs
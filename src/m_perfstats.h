@@ -42,17 +42,25 @@ extern ps_metric_t ps_thinkertime;
 extern ps_metric_t ps_thlist_times[];
 
 extern ps_metric_t ps_checkposition_calls;
+extern ps_metric_t ps_sightcache_hits;
+extern ps_metric_t ps_sightcache_misses;
 
 extern ps_metric_t ps_lua_prethinkframe_time;
 extern ps_metric_t ps_lua_thinkframe_time;
 extern ps_metric_t ps_lua_postthinkframe_time;
+extern ps_metric_t ps_lua_tasks_time;
 extern ps_metric_t ps_lua_mobjhooks;
+extern ps_metric_t ps_lua_taskcount;
+
+extern ps_metric_t ps_lua_gctime;
+extern ps_metric_t ps_lua_heapkb;
 
 extern ps_metric_t ps_otherlogictime;
 
 void PS_SetPreThinkFrameHookInfo(int index, precise_t time_taken, char* short_src);
 void PS_SetThinkFrameHookInfo(int index, precise_t time_taken, char* short_src);
 void PS_SetPostThinkFrameHookInfo(int index, precise_t time_taken, char* short_src);
+void PS_SetHUDHookInfo(int index, precise_t time_taken, char* short_src);
 
 void PS_UpdateTickStats(void);
 
@@ -105,6 +105,11 @@ static tic_t gametime = 0;
 static CV_PossibleValue_t netticbuffer_cons_t[] = {{0, "MIN"}, {3, "MAX"}, {0, NULL}};
 consvar_t cv_netticbuffer = CVAR_INIT ("netticbuffer", "1", CV_SAVE, netticbuffer_cons_t, NULL);
 
+// Maximum number of tics of input the server may hold back for a jittery client.
+// Only the server reads it, so it is a server setting like resynchattempts.
+static CV_PossibleValue_t jitterbuffer_cons_t[] = {{0, "MIN"}, {MAXJITTERBUFFER, "MAX"}, {0, NULL}};
+consvar_t cv_jitterbuffer = CVAR_INIT ("jitterbuffer", "0", CV_SAVE|CV_NETVAR, jitterbuffer_cons_t, NULL);
+
 static CV_PossibleValue_t resynchattempts_cons_t[] = {{1, "MIN"}, {20, "MAX"}, {0, "No"}, {0, NULL}};
 consvar_t cv_resynchattempts = CVAR_INIT ("resynchattempts", "10", CV_SAVE|CV_NETVAR, resynchattempts_cons_t, NULL);
 
@@ -126,6 +131,7 @@ void ResetNode(INT32 node)
 	memset(&netnodes[node], 0, sizeof(*netnodes));
 	netnodes[node].player = -1;
 	netnodes[node].player2 = -1;
+	SV_ResetJitterBuffer(node);
 }
 
 void CL_Reset(void)
@@ -67,13 +67,14 @@ extern tic_t neededtic;
 extern INT16 consistancy[BACKUPTICS];
 
 void Command_Ping_f(void);
+void Command_NetStats_f(void);
 extern tic_t connectiontimeout;
 extern UINT16 pingmeasurecount;
 extern UINT32 realpingtable[MAXPLAYERS];
 extern UINT32 playerpingtable[MAXPLAYERS];
 extern tic_t servermaxping;
 
-extern consvar_t cv_netticbuffer, cv_resynchattempts, cv_blamecfail, cv_playbackspeed, cv_idletime, cv_idleaction, cv_dedicatedidletime;
+extern consvar_t cv_netticbuffer, cv_jitterbuffer, cv_resynchattempts, cv_blamecfail, cv_playbackspeed, cv_idletime, cv_idleaction, cv_dedicatedidletime;
 extern consvar_t cv_httpsource;
 
 // Used in d_net, the only dependence
@@ -16,6 +16,8 @@
 ///        This protocol uses a mix of "goback n" and "selective repeat" implementation
 ///        The NOTHING packet is sent when connection is idle to acknowledge packets
 
+#include <time.h>
+
 #include "../doomdef.h"
 #include "../g_game.h"
 #include "../i_time.h"
@@ -127,22 +129,300 @@ boolean Net_GetNetStat(void)
 	return 0;
 }
 
+/// \warning Keep this up-to-date if you add/remove/rename packet types
+static const char *packettypename[NUMPACKETTYPE] =
+{
+	"NOTHING",
+	"SERVERCFG",
+	"CLIENTCMD",
+	"CLIENTMIS",
+	"CLIENT2CMD",
+	"CLIENT2MIS",
+	"NODEKEEPALIVE",
+	"NODEKEEPALIVEMIS",
+	"SERVERTICS",
+	"SERVERREFUSE",
+	"SERVERSHUTDOWN",
+	"CLIENTQUIT",
+
+	"ASKINFO",
+	"SERVERINFO",
+	"PLAYERINFO",
+	"REQUESTFILE",
+	"ASKINFOVIAMS",
+
+	"WILLRESENDGAMESTATE",
+	"CANRECEIVEGAMESTATE",
+	"RECEIVEDGAMESTATE",
+
+	"SENDINGLUAFILE",
+	"ASKLUAFILE",
+	"HASLUAFILE",
+
+	"PT_BASICKEEPALIVE",
+
+	"FILEFRAGMENT",
+	"FILEACK",
+	"FILERECEIVED",
+
+	"TEXTCMD",
+	"TEXTCMD2",
+	"CLIENTJOIN",
+	"LOGIN",
+	"TELLFILESNEEDED",
+	"MOREFILESNEEDED",
+	"PING"
+};
+
+// Per-node and per-packet-type statistics, cumulative so they can be graphed
+#define NUMRTTBUCKETS 8 // Under 16 ms, 32 ms... 1024 ms, then everything above
+#define PACKETSIZEBUCKET 128
+#define NUMPACKETSIZEBUCKETS ((MAXPACKETLENGTH + PACKETSIZEBUCKET - 1) / PACKETSIZEBUCKET)
+
+typedef struct
+{
+	UINT32 sentpackets, getpackets;
+	UINT64 sentbytes, getbytes;
+	UINT32 roundtrips; // Reliable packets acknowledged without being resent
+	UINT32 rttmin, rttmax; // In milliseconds
+	UINT64 rttsum;
+	UINT32 rtthistogram[NUMRTTBUCKETS];
+	UINT32 retransmits;
+	UINT32 duplicates;
+	UINT32 resendfrom; // Tics the client asked to be resent
+} nodestat_t;
+
+typedef struct
+{
+	UINT32 sentpackets, getpackets;
+	UINT64 sentbytes, getbytes;
+	UINT32 sizehistogram[NUMPACKETSIZEBUCKETS]; // Sizes of the sent packets
+} packetstat_t;
+
+static nodestat_t nodestats[MAXNETNODES];
+static packetstat_t packetstats[NUMPACKETTYPE];
+static tic_t netstatlogtic;
+
+static void ResetNodeStat(INT32 node)
+{
+	memset(&nodestats[node], 0, sizeof(nodestats[node]));
+	nodestats[node].rttmin = UINT32_MAX;
+}
+
+static void CountSentPacket(INT32 node)
+{
+	const UINT8 type = netbuffer->packettype;
+
+	if (node < MAXNETNODES)
+	{
+		nodestats[node].sentpackets++;
+		nodestats[node].sentbytes += doomcom->datalength;
+	}
+
+	if (type < NUMPACKETTYPE)
+	{
+		packetstats[type].sentpackets++;
+		packetstats[type].sentbytes += doomcom->datalength;
+		packetstats[type].sizehistogram[min(doomcom->datalength / PACKETSIZEBUCKET, NUMPACKETSIZEBUCKETS - 1)]++;
+	}
+}
+
+static void CountReceivedPacket(INT32 node)
+{
+	const UINT8 type = netbuffer->packettype;
+
+	nodestats[node].getpackets++;
+	nodestats[node].getbytes += doomcom->datalength;
+
+	if (type < NUMPACKETTYPE)
+	{
+		packetstats[type].getpackets++;
+		packetstats[type].getbytes += doomcom->datalength;
+	}
+}
+
+static void CountRoundTrip(INT32 node, precise_t senttime)
+{
+	nodestat_t *stat = &nodestats[node];
+	const UINT32 ms = (UINT32)((I_GetPreciseTime() - senttime) * 1000 / I_GetPrecisePrecision());
+	INT32 bucket = 0;
+
+	while (bucket < NUMRTTBUCKETS - 1 && ms >= (16u << bucket))
+		bucket++;
+
+	stat->roundtrips++;
+	stat->rttsum += ms;
+	stat->rttmin = min(stat->rttmin, ms);
+	stat->rttmax = max(stat->rttmax, ms);
+	stat->rtthistogram[bucket]++;
+}
+
+void Net_CountResendFrom(INT32 node)
+{
+	nodestats[node].resendfrom++;
+}
+
+static const char *GetNodeStatName(INT32 node)
+{
+	if (node == 0)
+		return "self";
+	if (netnodes[node].ingame && netnodes[node].player >= 0)
+		return player_names[(UINT8)netnodes[node].player];
+	return "-";
+}
+
+/** Appends the current statistics to netstats.csv
+  *
+  */
+static void WriteNetStatLog(void)
+{
+	const char *path = va("%s" PATHSEP "%s", srb2home, "netstats.csv");
+	const time_t now = time(NULL);
+	boolean newfile;
+	FILE *f;
+
+	f = fopen(path, "r");
+	newfile = (f == NULL);
+	if (f)
+		fclose(f);
+
+	f = fopen(path, "a");
+	if (!f)
+	{
+		CONS_Alert(CONS_WARNING, M_GetText("Couldn't write %s, disabling netstatlog\n"), path);
+		CV_StealthSetValue(&cv_netstatlog, 0);
+		return;
+	}
+
+	if (newfile)
+	{
+		fprintf(f, "node,time,tic,nodeid,name,sentpackets,getpackets,sentbytes,getbytes,"
+			"roundtrips,rttmin,rttavg,rttmax,retransmits,duplicates,resendfrom");
+		for (INT32 i = 0; i < NUMRTTBUCKETS; i++)
+			fprintf(f, ",rtt%d", i);
+		fprintf(f, "\n");
+
+		fprintf(f, "packet,time,tic,type,sentpackets,getpackets,sentbytes,getbytes");
+		for (INT32 i = 0; i < NUMPACKETSIZEBUCKETS; i++)
+			fprintf(f, ",size%d", i * PACKETSIZEBUCKET);
+		fprintf(f, "\n");
+	}
+
+	for (INT32 i = 0; i < MAXNETNODES; i++)
+	{
+		const nodestat_t *stat = &nodestats[i];
+
+		if (!stat->sentpackets && !stat->getpackets)
+			continue;
+
+		fprintf(f, "node,%ld,%u,%d,\"%s\",%u,%u,%s,%s,%u,%u,%u,%u,%u,%u,%u",
+			(long)now, gametic, i, GetNodeStatName(i),
+			stat->sentpackets, stat->getpackets,
+			sizeu1((size_t)stat->sentbytes), sizeu2((size_t)stat->getbytes),
+			stat->roundtrips,
+			stat->roundtrips ? stat->rttmin : 0,
+			stat->roundtrips ? (UINT32)(stat->rttsum / stat->roundtrips) : 0,
+			stat->rttmax,
+			stat->retransmits, stat->duplicates, stat->resendfrom);
+		for (INT32 j = 0; j < NUMRTTBUCKETS; j++)
+			fprintf(f, ",%u", stat->rtthistogram[j]);
+		fprintf(f, "\n");
+	}
+
+	for (INT32 i = 0; i < NUMPACKETTYPE; i++)
+	{
+		const packetstat_t *stat = &packetstats[i];
+
+		if (!stat->sentpackets && !stat->getpackets)
+			continue;
+
+		fprintf(f, "packet,%ld,%u,%s,%u,%u,%s,%s",
+			(long)now, gametic, packettypename[i],
+			stat->sentpackets, stat->getpackets,
+			sizeu1((size_t)stat->sentbytes), sizeu2((size_t)stat->getbytes));
+		for (INT32 j = 0; j < NUMPACKETSIZEBUCKETS; j++)
+			fprintf(f, ",%u", stat->sizehistogram[j]);
+		fprintf(f, "\n");
+	}
+
+	fclose(f);
+}
+
+/** Dumps the statistics every netstatlog seconds
+  *
+  */
+static void NetStatLogTicker(void)
+{
+	if (!cv_netstatlog.value)
+		return;
+
+	if (I_GetTime() < netstatlogtic)
+		return;
+
+	netstatlogtic = I_GetTime() + cv_netstatlog.value * TICRATE;
+	WriteNetStatLog();
+}
+
+void Command_NetStats_f(void)
+{
+	if (COM_Argc() >= 2)
+	{
+		if (!stricmp(COM_Argv(1), "reset"))
+		{
+			for (INT32 i = 0; i < MAXNETNODES; i++)
+				ResetNodeStat(i);
+			memset(packetstats, 0, sizeof(packetstats));
+			return;
+		}
+		else if (!stricmp(COM_Argv(1), "dump"))
+		{
+			WriteNetStatLog();
+			CONS_Printf(M_GetText("Network statistics written to %s\n"), "netstats.csv");
+			return;
+		}
+
+		CONS_Printf("netstats [reset|dump]: show, clear or write network statistics\n");
+		return;
+	}
+
+	CONS_Printf("\x82%-4s %-16s %8s %8s %10s %10s %5s %5s %5s %6s %6s %6s\n",
+		"node", "name", "sent", "got", "sentbytes", "gotbytes",
+		"rttlo", "rtt", "rtthi", "resent", "dups", "resend");
+
+	for (INT32 i = 0; i < MAXNETNODES; i++)
+	{
+		const nodestat_t *stat = &nodestats[i];
+
+		if (!stat->sentpackets && !stat->getpackets)
+			continue;
+
+		CONS_Printf("%-4d %-16.16s %8u %8u %10s %10s %5u %5u %5u %6u %6u %6u\n",
+			i, GetNodeStatName(i), stat->sentpackets, stat->getpackets,
+			sizeu1((size_t)stat->sentbytes), sizeu2((size_t)stat->getbytes),
+			stat->roundtrips ? stat->rttmin : 0,
+			stat->roundtrips ? (UINT32)(stat->rttsum / stat->roundtrips) : 0,
+			stat->rttmax, stat->retransmits, stat->duplicates, stat->resendfrom);
+	}
+}
+
 // -----------------------------------------------------------------
 // Some structs and functions for acknowledgement of packets
 // -----------------------------------------------------------------
-#define MAXACKPACKETS 96 // Minimum number of nodes (wat)
+#define MAXACKPACKETS 384 // Shared by all nodes
 #define MAXACKTOSEND 96
+#define ACKRINGSIZE (MAXACKTOSEND + 1) // More than a node can have waiting at once
 #define URGENTFREESLOTNUM 10
 #define ACKTOSENDTIMEOUT (TICRATE/11)
+#define SELECTIVEACKS 8 // Number of acks following ackreturn described by acksbitmap
 
 typedef struct
 {
 	UINT8 acknum;
 	UINT8 nextacknum;
-	UINT8 destinationnode; // The node to send the ack to
 	tic_t senttime; // The time when the ack was sent
 	UINT16 length; // The packet size
 	UINT16 resentnum; // The number of times the ack has been resent
+	precise_t firstsenttime; // For round trip statistics
 	union {
 		SINT8 raw[MAXPACKETLENGTH];
 		doomdata_t data;
@@ -155,8 +435,10 @@ typedef enum
 	NF_TIMEOUT = 2, // Flag is set when the node got a timeout
 } node_flags_t;
 
-// Table of packets that were not acknowleged can be resent (the sender window)
+// Packets that were not acknowleged and can be resent, shared by the sender window of every node
 static ackpak_t ackpak[MAXACKPACKETS];
+static INT16 freeackpak[MAXACKPACKETS]; // Stack of the unused entries in ackpak
+static INT32 numfreeackpak;
 
 typedef struct
 {
@@ -178,6 +460,12 @@ typedef struct
 	UINT8 remotefirstack;
 	UINT8 nextacknum;
 
+	// the sender window: packets waiting for an ack, oldest first,
+	// as indexes in ackpak, or -1 once acknowledged out of order
+	INT16 ackring[ACKRINGSIZE];
+	UINT8 ackring_tail;
+	UINT8 ackring_count;
+
 	UINT8 flags;
 } node_t;
 
@@ -197,6 +485,55 @@ FUNCMATH static INT32 cmpack(UINT8 a, UINT8 b)
 	return d;
 }
 
+// Acknums skip 0, which means "no ack"
+static UINT8 NextAcknum(UINT8 ack)
+{
+	ack++;
+	if (!ack)
+		ack++;
+	return ack;
+}
+
+// Number of acknums from a to b, 0 if b isn't after a
+FUNCMATH static INT32 AckDistance(UINT8 a, UINT8 b)
+{
+	INT32 d = (UINT8)(b - a);
+
+	if (cmpack(a, b) >= 0)
+		return 0;
+	if (b < a) // Skipped 0
+		d--;
+	return d;
+}
+
+#define ACKRINGPOS(node, i) (((node)->ackring_tail + (i)) % ACKRINGSIZE)
+
+/** Frees the ackpak entry of a packet in the sender window of a node
+  * It stays in the window until CompactAckRing is called
+  *
+  * \param node The destination of the packet
+  * \param pos The position of the packet in the window
+  *
+  */
+static void ReleaseAck(node_t *node, INT32 pos)
+{
+	const INT16 i = node->ackring[pos];
+
+	ackpak[i].acknum = 0;
+	freeackpak[numfreeackpak++] = i;
+	node->ackring[pos] = -1;
+}
+
+// Drops the acknowledged packets from the back of the sender window
+static void CompactAckRing(node_t *node)
+{
+	while (node->ackring_count && node->ackring[node->ackring_tail] == -1)
+	{
+		node->ackring_tail = (UINT8)((node->ackring_tail + 1) % ACKRINGSIZE);
+		node->ackring_count--;
+	}
+}
+
 /** Sets freeack to a free acknum and copies the netbuffer in the ackpak table
   *
   * \param freeack  The address to store the free acknum at
@@ -206,57 +543,58 @@ FUNCMATH static INT32 cmpack(UINT8 a, UINT8 b)
 static boolean GetFreeAcknum(UINT8 *freeack, boolean lowtimer)
 {
 	node_t *node = &nodes[doomcom->remotenode];
-	INT32 numfreeslot = 0;
+	ackpak_t *pak;
+	INT16 i;
 
-	if (cmpack((UINT8)((node->remotefirstack + MAXACKTOSEND) % 256), node->nextacknum) < 0)
+	if (cmpack((UINT8)((node->remotefirstack + MAXACKTOSEND) % 256), node->nextacknum) < 0
+		|| node->ackring_count >= ACKRINGSIZE)
 	{
 		DEBFILE(va("too fast %d %d\n",node->remotefirstack,node->nextacknum));
 		return false;
 	}
 
-	for (INT32 i = 0; i < MAXACKPACKETS; i++)
-		if (!ackpak[i].acknum)
-		{
-			// For low priority packets, make sure to let freeslots so urgent packets can be sent
-			if (netbuffer->packettype >= PT_CANFAIL)
-			{
-				numfreeslot++;
-				if (numfreeslot <= URGENTFREESLOTNUM)
-					continue;
-			}
+	// For low priority packets, make sure to let freeslots so urgent packets can be sent
+	if (numfreeackpak == 0
+		|| (netbuffer->packettype >= PT_CANFAIL && numfreeackpak <= URGENTFREESLOTNUM))
+	{
+#ifdef PARANOIA
+		CONS_Debug(DBG_NETPLAY, "No more free ackpacket\n");
+#endif
+		if (netbuffer->packettype < PT_CANFAIL)
+			I_Error("Connection lost\n");
+		return false;
+	}
 
-			ackpak[i].acknum = node->nextacknum;
-			ackpak[i].nextacknum = node->nextacknum;
-			node->nextacknum++;
-			if (!node->nextacknum)
-				node->nextacknum++;
-			ackpak[i].destinationnode = (UINT8)(node - nodes);
-			ackpak[i].length = doomcom->datalength;
-			if (lowtimer)
-			{
-				// Lowtime means can't be sent now so try it as soon as possible
-				ackpak[i].senttime = 0;
-				ackpak[i].resentnum = 1;
-			}
-			else
-			{
-				ackpak[i].senttime = I_GetTime();
-				ackpak[i].resentnum = 0;
-			}
-			M_Memcpy(ackpak[i].pak.raw, netbuffer, ackpak[i].length);
+	i = freeackpak[--numfreeackpak];
+	pak = &ackpak[i];
 
-			*freeack = ackpak[i].acknum;
+	pak->acknum = node->nextacknum;
+	pak->nextacknum = node->nextacknum;
+	node->nextacknum = NextAcknum(node->nextacknum);
+	pak->length = doomcom->datalength;
+	if (lowtimer)
+	{
+		// Lowtime means can't be sent now so try it as soon as possible
+		pak->senttime = 0;
+		pak->resentnum = 1;
+	}
+	else
+	{
+		pak->senttime = I_GetTime();
+		pak->resentnum = 0;
+	}
+	pak->firstsenttime = I_GetPreciseTime();
+	M_Memcpy(pak->pak.raw, netbuffer, pak->length);
 
-			sendackpacket++; // For stat
+	// Acknums are given in order, so the window stays sorted
+	node->ackring[ACKRINGPOS(node, node->ackring_count)] = i;
+	node->ackring_count++;
 
-			return true;
-		}
-#ifdef PARANOIA
-	CONS_Debug(DBG_NETPLAY, "No more free ackpacket\n");
-#endif
-	if (netbuffer->packettype < PT_CANFAIL)
-		I_Error("Connection lost\n");
-	return false;
+	*freeack = pak->acknum;
+
+	sendackpacket++; // For stat
+
+	return true;
 }
 
 /** Counts how many acks are free
@@ -271,24 +609,11 @@ static boolean GetFreeAcknum(UINT8 *freeack, boolean lowtimer)
   */
 INT32 Net_GetFreeAcks(boolean urgent)
 {
-	INT32 numfreeslot = 0;
-	INT32 n = 0; // Number of free acks found
-
-	for (INT32 i = 0; i < MAXACKPACKETS; i++)
-		if (!ackpak[i].acknum)
-		{
-			// For low priority packets, make sure to let freeslots so urgent packets can be sent
-			if (!urgent)
-			{
-				numfreeslot++;
-				if (numfreeslot <= URGENTFREESLOTNUM)
-					continue;
-			}
-
-			n++;
-		}
+	// For low priority packets, make sure to let freeslots so urgent packets can be sent
+	if (!urgent)
+		return max(numfreeackpak - URGENTFREESLOTNUM, 0);
 
-	return n;
+	return numfreeackpak;
 }
 
 // Get a ack to send in the queue of this node
@@ -298,13 +623,95 @@ static UINT8 GetAcktosend(INT32 node)
 	return nodes[node].firstacktosend;
 }
 
-static void RemoveAck(INT32 i)
+// A packet of the sender window of a node was acknowledged
+static void RemoveAck(INT32 nodenum, INT32 pos)
 {
-	INT32 node = ackpak[i].destinationnode;
-	DEBFILE(va("Remove ack %d\n",ackpak[i].acknum));
-	ackpak[i].acknum = 0;
-	if (nodes[node].flags & NF_CLOSE)
-		Net_CloseConnection(node);
+	node_t *node = &nodes[nodenum];
+	ackpak_t *pak = &ackpak[node->ackring[pos]];
+
+	DEBFILE(va("Remove ack %d\n",pak->acknum));
+	if (!pak->resentnum)
+		CountRoundTrip(nodenum, pak->firstsenttime);
+	ReleaseAck(node, pos);
+}
+
+// Call after removing acks, closes the connection once everything was acknowledged if needed
+static void FinishRemoveAcks(INT32 nodenum, INT32 oldnumfreeackpak)
+{
+	CompactAckRing(&nodes[nodenum]);
+	if (numfreeackpak != oldnumfreeackpak && (nodes[nodenum].flags & NF_CLOSE))
+		Net_CloseConnection(nodenum);
+}
+
+/** Builds the selective ack bitmap for the packet being sent:
+  * bit n is set if the packet with ackreturn + n + 1 was received
+  *
+  * \param node The destination
+  * \return The bitmap
+  *
+  */
+static UINT8 GetSelectiveAcks(INT32 node)
+{
+	node_t *n = &nodes[node];
+	UINT8 bitmap = 0;
+
+	if (!n->firstacktosend)
+		return 0;
+
+	for (INT32 i = n->acktosend_tail; i != n->acktosend_head; i = (i+1) % MAXACKTOSEND)
+	{
+		const INT32 d = AckDistance(n->firstacktosend, n->acktosend[i]);
+
+		if (d >= 1 && d <= SELECTIVEACKS)
+			bitmap |= 1 << (d - 1);
+	}
+
+	return bitmap;
+}
+
+/** Removes the packets acknowledged by the selective ack bitmap of the received packet,
+  * and makes the ones it skipped be resent without waiting for a timeout
+  *
+  */
+static void GotSelectiveAcks(void)
+{
+	node_t *node = &nodes[doomcom->remotenode];
+	const UINT8 ackreturn = netbuffer->ackreturn;
+	const UINT8 bitmap = netbuffer->acksbitmap;
+	UINT8 highest = ackreturn;
+
+	for (INT32 n = 0; n < SELECTIVEACKS; n++)
+		if (bitmap & (1 << n))
+		{
+			highest = ackreturn;
+			for (INT32 k = 0; k <= n; k++)
+				highest = NextAcknum(highest);
+		}
+
+	for (INT32 i = 0; i < node->ackring_count; i++)
+	{
+		const INT32 pos = ACKRINGPOS(node, i);
+		ackpak_t *pak;
+		INT32 d;
+
+		if (node->ackring[pos] == -1)
+			continue;
+
+		pak = &ackpak[node->ackring[pos]];
+		d = AckDistance(ackreturn, pak->acknum);
+
+		if (d > SELECTIVEACKS)
+			break; // The window is sorted
+
+		if (d >= 1 && (bitmap & (1 << (d - 1))))
+			RemoveAck(doomcom->remotenode, pos);
+		// A later packet made it but this one didn't, it is most likely lost
+		else if (cmpack(pak->acknum, highest) < 0
+			&& cmpack(pak->nextacknum, highest) <= 0 && pak->senttime > 0)
+		{
+			pak->senttime = 0;
+		}
+	}
 }
 
 // We have got a packet, proceed the ack request and ack return
@@ -314,16 +721,30 @@ static int Processackpak(void)
 	node_t *node = &nodes[doomcom->remotenode];
 
 	// Received an ack return, so remove the ack in the list
-	if (netbuffer->ackreturn && cmpack(node->remotefirstack, netbuffer->ackreturn) < 0)
+	if (netbuffer->ackreturn)
 	{
-		node->remotefirstack = netbuffer->ackreturn;
-		// Search the ackbuffer and free it
-		for (INT32 i = 0; i < MAXACKPACKETS; i++)
-			if (ackpak[i].acknum && ackpak[i].destinationnode == node - nodes
-				&& cmpack(ackpak[i].acknum, netbuffer->ackreturn) <= 0)
+		const INT32 oldnumfreeackpak = numfreeackpak;
+
+		if (cmpack(node->remotefirstack, netbuffer->ackreturn) < 0)
+		{
+			node->remotefirstack = netbuffer->ackreturn;
+			// Everything up to the ack return was received, and the window is sorted
+			for (INT32 i = 0; i < node->ackring_count; i++)
 			{
-				RemoveAck(i);
+				const INT32 pos = ACKRINGPOS(node, i);
+
+				if (node->ackring[pos] == -1)
+					continue;
+				if (cmpack(ackpak[node->ackring[pos]].acknum, netbuffer->ackreturn) > 0)
+					break;
+				RemoveAck(doomcom->remotenode, pos);
 			}
+		}
+
+		if (netbuffer->acksbitmap)
+			GotSelectiveAcks();
+
+		FinishRemoveAcks(doomcom->remotenode, oldnumfreeackpak);
 	}
 
 	// Received a packet with ack, queue it to send the ack back
@@ -335,6 +756,7 @@ static int Processackpak(void)
 		{
 			DEBFILE(va("Discard(1) ack %d (duplicated)\n", ack));
 			duppacket++;
+			nodestats[node - nodes].duplicates++;
 			goodpacket = 1; // Discard packet (duplicate)
 		}
 		else
@@ -345,6 +767,7 @@ static int Processackpak(void)
 				{
 					DEBFILE(va("Discard(2) ack %d (duplicated)\n", ack));
 					duppacket++;
+					nodestats[node - nodes].duplicates++;
 					goodpacket = 1; // Discard packet (duplicate)
 					break;
 				}
@@ -429,23 +852,34 @@ void Net_SendAcks(INT32 node)
 
 static void GotAcks(void)
 {
+	node_t *node = &nodes[doomcom->remotenode];
+	const INT32 oldnumfreeackpak = numfreeackpak;
+
 	for (INT32 j = 0; j < MAXACKTOSEND; j++)
 		if (netbuffer->u.textcmd[j])
-			for (INT32 i = 0; i < MAXACKPACKETS; i++)
-				if (ackpak[i].acknum && ackpak[i].destinationnode == doomcom->remotenode)
-				{
-					if (ackpak[i].acknum == netbuffer->u.textcmd[j])
-						RemoveAck(i);
-					// nextacknum is first equal to acknum, then when receiving bigger ack
-					// there is big chance the packet is lost
-					// When resent, nextacknum = nodes[node].nextacknum
-					// will redo the same but with different value
-					else if (cmpack(ackpak[i].nextacknum, netbuffer->u.textcmd[j]) <= 0
-							&& ackpak[i].senttime > 0)
-						{
-							ackpak[i].senttime--; // hurry up
-						}
-				}
+			for (INT32 i = 0; i < node->ackring_count; i++)
+			{
+				const INT32 pos = ACKRINGPOS(node, i);
+				ackpak_t *pak;
+
+				if (node->ackring[pos] == -1)
+					continue;
+
+				pak = &ackpak[node->ackring[pos]];
+				if (pak->acknum == netbuffer->u.textcmd[j])
+					RemoveAck(doomcom->remotenode, pos);
+				// nextacknum is first equal to acknum, then when receiving bigger ack
+				// there is big chance the packet is lost
+				// When resent, nextacknum = nodes[node].nextacknum
+				// will redo the same but with different value
+				else if (cmpack(pak->nextacknum, netbuffer->u.textcmd[j]) <= 0
+						&& pak->senttime > 0)
+					{
+						pak->senttime--; // hurry up
+					}
+			}
+
+	FinishRemoveAcks(doomcom->remotenode, oldnumfreeackpak);
 }
 
 void Net_ConnectionTimeout(INT32 node)
@@ -468,31 +902,39 @@ void Net_ConnectionTimeout(INT32 node)
 // Resend the data if needed
 void Net_AckTicker(void)
 {
-
-	for (INT32 i = 0; i < MAXACKPACKETS; i++)
+	for (INT32 nodei = 0; nodei < MAXNETNODES; nodei++)
 	{
-		const INT32 nodei = ackpak[i].destinationnode;
 		node_t *node = &nodes[nodei];
-		if (ackpak[i].acknum && ackpak[i].senttime + NODETIMEOUT < I_GetTime())
+
+		for (INT32 i = 0; i < node->ackring_count; i++)
 		{
-			if (ackpak[i].resentnum > 20 && (node->flags & NF_CLOSE))
+			const INT32 pos = ACKRINGPOS(node, i);
+			ackpak_t *pak;
+
+			if (node->ackring[pos] == -1)
+				continue;
+
+			pak = &ackpak[node->ackring[pos]];
+			if (pak->senttime + NODETIMEOUT >= I_GetTime())
+				continue;
+
+			if (pak->resentnum > 20 && (node->flags & NF_CLOSE))
 			{
 				DEBFILE(va("ack %d sent 20 times so connection is supposed lost: node %d\n",
-					i, nodei));
+					pak->acknum, nodei));
 				Net_CloseConnection(nodei | FORCECLOSE);
-
-				ackpak[i].acknum = 0;
-				continue;
+				break; // The window was cleared
 			}
-			DEBFILE(va("Resend ack %d, %u<%d at %u\n", ackpak[i].acknum, ackpak[i].senttime,
+			DEBFILE(va("Resend ack %d, %u<%d at %u\n", pak->acknum, pak->senttime,
 				NODETIMEOUT, I_GetTime()));
-			M_Memcpy(netbuffer, ackpak[i].pak.raw, ackpak[i].length);
-			ackpak[i].senttime = I_GetTime();
-			ackpak[i].resentnum++;
-			ackpak[i].nextacknum = node->nextacknum;
+			M_Memcpy(netbuffer, pak->pak.raw, pak->length);
+			pak->senttime = I_GetTime();
+			pak->resentnum++;
+			pak->nextacknum = node->nextacknum;
 			retransmit++; // For stat
-			HSendPacket((INT32)(node - nodes), false, ackpak[i].acknum,
-				(size_t)(ackpak[i].length - BASEPACKETSIZE));
+			nodestats[nodei].retransmits++;
+			HSendPacket(nodei, false, pak->acknum,
+				(size_t)(pak->length - BASEPACKETSIZE));
 		}
 	}
 
@@ -513,6 +955,8 @@ void Net_AckTicker(void)
 			}
 		}
 	}
+
+	NetStatLogTicker();
 }
 
 // Remove last packet received ack before resending the ackreturn
@@ -559,11 +1003,7 @@ void Net_UnAcknowledgePacket(INT32 node)
   */
 static boolean Net_AllAcksReceived(void)
 {
-	for (INT32 i = 0; i < MAXACKPACKETS; i++)
-		if (ackpak[i].acknum)
-			return false;
-
-	return true;
+	return numfreeackpak == MAXACKPACKETS;
 }
 
 /** Waits for all ackreturns
@@ -596,13 +1036,19 @@ static void InitNode(node_t *node)
 	node->firstacktosend = 0;
 	node->nextacknum = 1;
 	node->remotefirstack = 0;
+	node->ackring_tail = node->ackring_count = 0;
 	node->flags = 0;
+	ResetNodeStat(node - nodes);
 }
 
 static void InitAck(void)
 {
 	for (INT32 i = 0; i < MAXACKPACKETS; i++)
+	{
 		ackpak[i].acknum = 0;
+		freeackpak[i] = (INT16)(MAXACKPACKETS - 1 - i);
+	}
+	numfreeackpak = MAXACKPACKETS;
 
 	for (INT32 i = 0; i < MAXNETNODES; i++)
 		InitNode(&nodes[i]);
@@ -615,12 +1061,24 @@ static void InitAck(void)
   */
 void Net_AbortPacketType(UINT8 packettype)
 {
-	for (INT32 i = 0; i < MAXACKPACKETS; i++)
-		if (ackpak[i].acknum && (ackpak[i].pak.data.packettype == packettype
-			|| packettype == UINT8_MAX))
+	for (INT32 n = 0; n < MAXNETNODES; n++)
+	{
+		node_t *node = &nodes[n];
+
+		for (INT32 i = 0; i < node->ackring_count; i++)
 		{
-			ackpak[i].acknum = 0;
+			const INT32 pos = ACKRINGPOS(node, i);
+
+			if (node->ackring[pos] != -1
+				&& (ackpak[node->ackring[pos]].pak.data.packettype == packettype
+				|| packettype == UINT8_MAX))
+			{
+				ReleaseAck(node, pos);
+			}
 		}
+
+		CompactAckRing(node);
+	}
 }
 
 // -----------------------------------------------------------------
@@ -659,14 +1117,16 @@ void Net_CloseConnection(INT32 node)
 	}
 
 	// check if we are waiting for an ack from this node
-	for (INT32 i = 0; i < MAXACKPACKETS; i++)
-		if (ackpak[i].acknum && ackpak[i].destinationnode == node)
-		{
-			if (!forceclose)
-				return; // connection will be closed when ack is returned
-			else
-				ackpak[i].acknum = 0;
-		}
+	if (nodes[node].ackring_count)
+	{
+		if (!forceclose)
+			return; // connection will be closed when ack is returned
+
+		for (INT32 i = 0; i < nodes[node].ackring_count; i++)
+			if (nodes[node].ackring[ACKRINGPOS(&nodes[node], i)] != -1)
+				ReleaseAck(&nodes[node], ACKRINGPOS(&nodes[node], i));
+		nodes[node].ackring_count = 0;
+	}
 
 	InitNode(&nodes[node]);
 	SV_AbortSendFiles(node);
@@ -726,51 +1186,6 @@ static void fprintfstringnewline(char *s, size_t len)
 	fprintf(debugfile, "\n");
 }
 
-/// \warning Keep this up-to-date if you add/remove/rename packet types
-static const char *packettypename[NUMPACKETTYPE] =
-{
-	"NOTHING",
-	"SERVERCFG",
-	"CLIENTCMD",
-	"CLIENTMIS",
-	"CLIENT2CMD",
-	"CLIENT2MIS",
-	"NODEKEEPALIVE",
-	"NODEKEEPALIVEMIS",
-	"SERVERTICS",
-	"SERVERREFUSE",
-	"SERVERSHUTDOWN",
-	"CLIENTQUIT",
-
-	"ASKINFO",
-	"SERVERINFO",
-	"PLAYERINFO",
-	"REQUESTFILE",
-	"ASKINFOVIAMS",
-
-	"WILLRESENDGAMESTATE",
-	"CANRECEIVEGAMESTATE",
-	"RECEIVEDGAMESTATE",
-
-	"SENDINGLUAFILE",
-	"ASKLUAFILE",
-	"HASLUAFILE",
-
-	"PT_BASICKEEPALIVE",
-
-	"FILEFRAGMENT",
-	"FILEACK",
-	"FILERECEIVED",
-
-	"TEXTCMD",
-	"TEXTCMD2",
-	"CLIENTJOIN",
-	"LOGIN",
-	"TELLFILESNEEDED",
-	"MOREFILESNEEDED",
-	"PING"
-};
-
 static void DebugPrintpacket(const char *header)
 {
 	fprintf(debugfile, "%-12s (node %d,ack %d,ackret %d,size %d) type(%d) : %s\n",
@@ -954,7 +1369,7 @@ boolean HSendPacket(INT32 node, boolean reliable, UINT8 acknum, size_t packetlen
 #endif
 			return false;
 		}
-		netbuffer->ack = netbuffer->ackreturn = 0; // don't hold over values from last packet sent/received
+		netbuffer->ack = netbuffer->ackreturn = netbuffer->acksbitmap = 0; // don't hold over values from last packet sent/received
 		M_Memcpy(&reboundstore[rebound_head], netbuffer,
 			doomcom->datalength);
 		reboundsize[rebound_head] = doomcom->datalength;
@@ -986,9 +1401,15 @@ boolean HSendPacket(INT32 node, boolean reliable, UINT8 acknum, size_t packetlen
 	}
 
 	if (node < MAXNETNODES) // Can be a broadcast
+	{
 		netbuffer->ackreturn = GetAcktosend(node);
+		netbuffer->acksbitmap = GetSelectiveAcks(node);
+	}
 	else
+	{
 		netbuffer->ackreturn = 0;
+		netbuffer->acksbitmap = 0;
+	}
 	if (reliable)
 	{
 		if (!GetFreeAcknum(&netbuffer->ack, false))
@@ -999,6 +1420,7 @@ boolean HSendPacket(INT32 node, boolean reliable, UINT8 acknum, size_t packetlen
 
 	netbuffer->checksum = NetbufferChecksum();
 	sendbytes += packetheaderlength + doomcom->datalength; // For stat
+	CountSentPacket(node);
 
 #ifdef PACKETDROP
 	// Simulate internet :)
@@ -1087,6 +1509,8 @@ boolean HGetPacket(void)
 			DebugPrintpacket("GET");
 #endif
 
+		CountReceivedPacket(doomcom->remotenode);
+
 		/*// If a new node sends an unexpected packet, just ignore it
 		if (nodejustjoined && server
 			&& !(netbuffer->packettype == PT_ASKINFO
@@ -36,6 +36,7 @@ extern INT32 getbps, sendbps;
 extern float lostpercent, duppercent, gamelostpercent;
 extern INT32 packetheaderlength;
 boolean Net_GetNetStat(void);
+void Net_CountResendFrom(INT32 node);
 extern INT32 getbytes;
 extern INT64 sendbytes; // Realtime updated
 
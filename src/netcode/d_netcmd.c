@@ -47,6 +47,7 @@
 #include "../z_zone.h"
 #include "../lua_script.h"
 #include "../lua_hook.h"
+#include "../lua_profile.h"
 #include "../m_cond.h"
 #include "../m_anigif.h"
 #include "../md5.h"
@@ -348,6 +349,8 @@ consvar_t cv_allowexitlevel = CVAR_INIT ("allowexitlevel", "No", CV_SAVE|CV_NETV
 consvar_t cv_killingdead = CVAR_INIT ("killingdead", "Off", CV_NETVAR|CV_ALLOWLUA, CV_OnOff, NULL);
 
 consvar_t cv_netstat = CVAR_INIT ("netstat", "Off", 0, CV_OnOff, NULL); // show bandwidth statistics
+static CV_PossibleValue_t netstatlog_cons_t[] = {{0, "MIN"}, {3600, "MAX"}, {0, NULL}};
+consvar_t cv_netstatlog = CVAR_INIT ("netstatlog", "0", CV_SAVE, netstatlog_cons_t, NULL); // seconds between netstats.csv dumps
 static CV_PossibleValue_t nettimeout_cons_t[] = {{TICRATE/7, "MIN"}, {60*TICRATE, "MAX"}, {0, NULL}};
 consvar_t cv_nettimeout = CVAR_INIT ("nettimeout", "350", CV_CALL|CV_SAVE, nettimeout_cons_t, NetTimeout_OnChange);
 static CV_PossibleValue_t jointimeout_cons_t[] = {{5*TICRATE, "MIN"}, {60*TICRATE, "MAX"}, {0, NULL}};
@@ -387,7 +390,7 @@ consvar_t cv_mute = CVAR_INIT ("mute", "Off", CV_NETVAR|CV_CALL|CV_ALLOWLUA, CV_
 consvar_t cv_sleep = CVAR_INIT ("cpusleep", "1", CV_SAVE, sleeping_cons_t, NULL);
 
 static CV_PossibleValue_t perfstats_cons_t[] = {
-	{0, "Off"}, {1, "Rendering"}, {2, "Logic"}, {3, "ThinkFrame"}, {4, "PreThinkFrame"}, {5, "PostThinkFrame"}, {0, NULL}};
+	{0, "Off"}, {1, "Rendering"}, {2, "Logic"}, {3, "ThinkFrame"}, {4, "PreThinkFrame"}, {5, "PostThinkFrame"}, {6, "HUD"}, {0, NULL}};
 consvar_t cv_perfstats = CVAR_INIT ("perfstats", "Off", CV_CALL, perfstats_cons_t, PS_PerfStats_OnChange);
 static CV_PossibleValue_t ps_samplesize_cons_t[] = {
 	{1, "MIN"}, {1000, "MAX"}, {0, NULL}};
@@ -544,6 +547,20 @@ void D_RegisterServerCommands(void)
 	CV_RegisterVar(&cv_itemrespawntime);
 	CV_RegisterVar(&cv_itemrespawn);
 	CV_RegisterVar(&cv_flagtime);
+	CV_RegisterVar(&cv_sleepmobjs);
+	CV_RegisterVar(&cv_sleepradius);
+
+	// p_tick.c
+	CV_RegisterVar(&cv_sortthinkers);
+
+	// lua_script.c
+	COM_AddCommand("luaarchivesize", Command_LuaArchiveSize_f, 0);
+
+	// lua_profile.c
+	COM_AddCommand("luaprofile", Command_LuaProfile_f, 0);
+
+	// lua_tasklib.c
+	CV_RegisterVar(&cv_luataskbudget);
 
 	// misc
 	CV_RegisterVar(&cv_friendlyfire);
@@ -612,9 +629,11 @@ void D_RegisterServerCommands(void)
 	CV_RegisterVar(&cv_joindelay);
 	CV_RegisterVar(&cv_rejointimeout);
 	CV_RegisterVar(&cv_resynchattempts);
+	CV_RegisterVar(&cv_jitterbuffer);
 	CV_RegisterVar(&cv_maxsend);
 	CV_RegisterVar(&cv_noticedownload);
 	CV_RegisterVar(&cv_downloadspeed);
+	CV_RegisterVar(&cv_downloadcongestion);
 	CV_RegisterVar(&cv_allownewplayer);
 	CV_RegisterVar(&cv_showjoinaddress);
 	CV_RegisterVar(&cv_blamecfail);
@@ -624,6 +643,8 @@ void D_RegisterServerCommands(void)
 	CV_RegisterVar(&cv_httpsource);
 
 	COM_AddCommand("ping", Command_Ping_f, COM_LUA);
+	COM_AddCommand("netstats", Command_NetStats_f, COM_LUA);
+	CV_RegisterVar(&cv_netstatlog);
 	CV_RegisterVar(&cv_nettimeout);
 	CV_RegisterVar(&cv_jointimeout);
 
@@ -679,11 +700,25 @@ void D_RegisterClientCommands(void)
 	CV_RegisterVar(&cv_flipcam2);
 	CV_RegisterVar(&cv_movebob);
 
+	// Local performance options, which a dedicated server runs the game with too
+
+	// p_tick.c
+	CV_RegisterVar(&cv_thinkerthreads);
+
+	// p_maputl.c
+	CV_RegisterVar(&cv_blockmapcells);
+
+	// lua_script.c
+	CV_RegisterVar(&cv_luagcscheduler);
+
 	if (dedicated)
 		return;
 
 	COM_AddCommand("numthinkers", Command_Numthinkers_f, COM_LUA);
 	COM_AddCommand("countmobjs", Command_CountMobjs_f, COM_LUA);
+#ifdef DEVELOP
+	COM_AddCommand("luaallocbench", Command_LuaAllocBench_f, 0);
+#endif
 
 	COM_AddCommand("changeteam", Command_Teamchange_f, COM_LUA);
 	COM_AddCommand("changeteam2", Command_Teamchange2_f, COM_LUA);
@@ -756,6 +791,7 @@ void D_RegisterClientCommands(void)
 	CV_RegisterVar(&cv_itemfinder);
 	CV_RegisterVar(&cv_showinput);
 	CV_RegisterVar(&cv_showinputjoy);
+	CV_RegisterVar(&cv_luahudbatching); // lua_hudlib_drawlist.c
 
 	// time attack ghost options are also saved to config
 	CV_RegisterVar(&cv_ghost_bestscore);
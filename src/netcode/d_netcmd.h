@@ -52,9 +52,22 @@ extern consvar_t cv_mouse2opt;
 // normally in p_mobj but the .h is not read
 extern consvar_t cv_itemrespawntime;
 extern consvar_t cv_itemrespawn;
+extern consvar_t cv_sleepmobjs, cv_sleepradius;
 
 extern consvar_t cv_flagtime;
 
+// normally in p_tick but the .h is not read
+extern consvar_t cv_sortthinkers;
+extern consvar_t cv_thinkerthreads;
+
+extern consvar_t cv_blockmapcells;
+
+extern consvar_t cv_luagcscheduler;
+
+extern consvar_t cv_luahudbatching;
+
+extern consvar_t cv_luataskbudget;
+
 extern consvar_t cv_touchtag;
 extern consvar_t cv_hidetime;
 
@@ -72,7 +85,7 @@ extern consvar_t cv_autobalance;
 extern consvar_t cv_teamscramble;
 extern consvar_t cv_scrambleonchange;
 
-extern consvar_t cv_netstat;
+extern consvar_t cv_netstat, cv_netstatlog;
 extern consvar_t cv_nettimeout;
 
 extern consvar_t cv_countdowntime;
@@ -28,6 +28,13 @@
 #include <utime.h>
 #endif
 
+#if defined (__unix__) || defined (__APPLE__) || defined (UNIXCOMMON)
+#include <sys/mman.h>
+#ifdef MAP_FAILED
+#define HAVE_MMAP
+#endif
+#endif
+
 #ifdef __GNUC__
 #include <unistd.h>
 #include <limits.h>
@@ -53,6 +60,7 @@
 #include "../m_misc.h"
 #include "../m_menu.h"
 #include "../md5.h"
+#include "../m_fixed.h"
 #include "../filesrch.h"
 
 #include <errno.h>
@@ -70,10 +78,21 @@ typedef struct filetx_s
 	} id;
 	UINT32 size; // Size of the file
 	UINT8 fileid;
+	UINT16 wadnum; // The addon being sent, UINT16_MAX if it isn't one
 	INT32 node; // Destination
 	struct filetx_s *next; // Next file in the list
 } filetx_t;
 
+// Per-fragment bookkeeping for congestion-controlled transfers
+typedef struct
+{
+	precise_t senttime; // When the fragment was last sent, 0 if it is not in flight
+	UINT8 sends; // Number of times the fragment has been sent
+	UINT32 prev, next; // Neighbours in the in-flight queue, NOFRAGMENT at either end
+} fragmentinfo_t;
+
+#define NOFRAGMENT UINT32_MAX
+
 // Current transfers (one for each node)
 typedef struct filetran_s
 {
@@ -84,10 +103,35 @@ typedef struct filetran_s
 	boolean *ackedfragments;
 	UINT32 ackedsize;
 	FILE *currentfile; // The file currently being sent/received
+	const UINT8 *mappeddata; // Shared contents of the addon being sent, if cached
 	tic_t dontsenduntil;
+
+	// Congestion control (cv_downloadcongestion)
+	fragmentinfo_t *fragmentinfo;
+	UINT32 inflight; // Fragments sent but neither acknowledged nor considered lost
+	UINT32 oldestfragment, newestfragment; // In-flight queue, in the order they were sent
+	UINT32 senttic; // Fragments sent during the current tic
+	fixed_t window; // Maximum number of fragments in flight
+	fixed_t ssthresh; // Slow start threshold
+	precise_t srtt; // Smoothed round-trip time, 0 if not measured yet
+	precise_t rttvar; // Round-trip time variation
+	precise_t lastloss; // When the window was last reduced
 } filetran_t;
 static filetran_t transfer[MAXNETNODES];
 
+// Addons being sent, loaded once and shared by every node downloading them
+typedef struct
+{
+	UINT8 *data;
+	UINT32 size;
+	INT32 refcount;
+	boolean mapped; // False if the file had to be read into memory instead
+#ifdef _WIN32
+	HANDLE mapping;
+#endif
+} sendcache_t;
+static sendcache_t sendcache[MAX_WADFILES];
+
 // Read time of file: stat _stmtime
 // Write time of file: utime
 
@@ -139,6 +183,9 @@ consvar_t cv_noticedownload = CVAR_INIT ("noticedownload", "Off", CV_SAVE|CV_NET
 static CV_PossibleValue_t downloadspeed_cons_t[] = {{1, "MIN"}, {300, "MAX"}, {0, NULL}};
 consvar_t cv_downloadspeed = CVAR_INIT ("downloadspeed", "16", CV_SAVE|CV_NETVAR, downloadspeed_cons_t, NULL);
 
+// Adapt the sending rate of each node to its link instead of using downloadspeed
+consvar_t cv_downloadcongestion = CVAR_INIT ("downloadcongestion", "Off", CV_SAVE, CV_OnOff, NULL);
+
 static UINT16 GetWadNumFromFileNeededId(UINT8 id)
 {
 	for (UINT16 wadnum = mainwads; wadnum < numwadfiles; wadnum++)
@@ -867,6 +914,7 @@ static boolean AddFileToSendQueue(INT32 node, UINT8 fileid)
 	DEBFILE(va("Sending file %s (id=%d) to %d\n", p->id.filename, fileid, node));
 	p->ram = SF_FILE; // It's a file, we need to close it and free its name once we're done sending it
 	p->fileid = fileid;
+	p->wadnum = wadnum;
 	p->next = NULL; // End of list
 	filestosend++;
 	return true;
@@ -951,11 +999,122 @@ boolean AddLuaFileToSendQueue(INT32 node, const char *filename)
 
 	DEBFILE(va("Sending Lua file %s to %d\n", filename, node));
 	p->ram = SF_FILE; // It's a file, we need to close it and free its name once we're done sending it
+	p->wadnum = UINT16_MAX; // Not an addon, don't cache it
 	p->next = NULL; // End of list
 	filestosend++;
 	return true;
 }
 
+/** Gets the contents of an addon to send, mapping it in memory if no other node is downloading it
+  *
+  * \param wadnum The addon to send
+  * \param filename The path of the addon
+  * \param size Where to store the size of the addon
+  * \return The contents of the addon, or NULL if it couldn't be cached
+  * \sa ReleaseSendCache
+  *
+  */
+static const UINT8 *AcquireSendCache(UINT16 wadnum, const char *filename, UINT32 *size)
+{
+	sendcache_t *cache = &sendcache[wadnum];
+
+	if (!cache->refcount)
+	{
+		FILE *handle;
+		long filesize;
+
+		handle = fopen(filename, "rb");
+		if (!handle)
+			return NULL;
+
+		fseek(handle, 0, SEEK_END);
+		filesize = ftell(handle);
+		fseek(handle, 0, SEEK_SET);
+
+		// Let the regular path deal with weird files
+		if (filesize <= 0 || filesize >= LONG_MAX)
+		{
+			fclose(handle);
+			return NULL;
+		}
+
+		cache->size = (UINT32)filesize;
+		cache->data = NULL;
+		cache->mapped = false;
+
+#if defined (_WIN32)
+		cache->mapping = CreateFileMapping((HANDLE)_get_osfhandle(_fileno(handle)), NULL, PAGE_READONLY, 0, 0, NULL);
+		if (cache->mapping)
+		{
+			cache->data = MapViewOfFile(cache->mapping, FILE_MAP_READ, 0, 0, 0);
+			if (cache->data)
+				cache->mapped = true;
+			else
+				CloseHandle(cache->mapping);
+		}
+#elif defined (HAVE_MMAP)
+		cache->data = mmap(NULL, cache->size, PROT_READ, MAP_SHARED, fileno(handle), 0);
+		if (cache->data == MAP_FAILED)
+			cache->data = NULL;
+		else
+			cache->mapped = true;
+#endif
+
+		// No mapping available, read it all once instead
+		if (!cache->data)
+		{
+			cache->data = malloc(cache->size);
+			if (!cache->data)
+				I_Error("AcquireSendCache: No more memory\n");
+
+			if (fread(cache->data, 1, cache->size, handle) != cache->size)
+			{
+				DEBFILE(va("Can't read %s for sending: %s\n", filename, M_FileError(handle)));
+				free(cache->data);
+				cache->data = NULL;
+				fclose(handle);
+				return NULL;
+			}
+		}
+
+		// The mapping stays valid after the file is closed
+		fclose(handle);
+	}
+
+	cache->refcount++;
+	*size = cache->size;
+	return cache->data;
+}
+
+/** Stops using the cached contents of an addon, freeing them if no other node needs them
+  *
+  * \param wadnum The addon that was being sent
+  * \sa AcquireSendCache
+  *
+  */
+static void ReleaseSendCache(UINT16 wadnum)
+{
+	sendcache_t *cache = &sendcache[wadnum];
+
+	if (--cache->refcount > 0)
+		return;
+
+	if (cache->mapped)
+	{
+#if defined (_WIN32)
+		UnmapViewOfFile(cache->data);
+		CloseHandle(cache->mapping);
+#elif defined (HAVE_MMAP)
+		munmap(cache->data, cache->size);
+#endif
+	}
+	else
+		free(cache->data);
+
+	cache->data = NULL;
+	cache->refcount = 0;
+}
+
 /** Stops sending a file for a node, and removes the file request from the list,
   * either because the file has been fully sent or because the node was disconnected
   *
@@ -973,7 +1132,9 @@ static void SV_EndFileSend(INT32 node)
 		case SF_FILE: // It's a file, close it and free its filename
 			if (cv_noticedownload.value)
 				CONS_Printf("Ending file transfer for node %d\n", node);
-			if (transfer[node].currentfile)
+			if (transfer[node].mappeddata)
+				ReleaseSendCache(p->wadnum);
+			else if (transfer[node].currentfile)
 				fclose(transfer[node].currentfile);
 			free(p->id.filename);
 			break;
@@ -992,25 +1153,360 @@ static void SV_EndFileSend(INT32 node)
 
 	// Indicate that the transmission is over
 	transfer[node].currentfile = NULL;
+	transfer[node].mappeddata = NULL;
 	if (transfer[node].ackedfragments)
 		free(transfer[node].ackedfragments);
 	transfer[node].ackedfragments = NULL;
+	if (transfer[node].fragmentinfo)
+		free(transfer[node].fragmentinfo);
+	transfer[node].fragmentinfo = NULL;
 
 	filestosend--;
 }
 
 #define FILEFRAGMENTSIZE (software_MAXPACKETLENGTH - (FILETXHEADER + BASEPACKETSIZE))
 
+// Congestion window limits, in fragments
+#define MINWINDOW 2
+#define MAXWINDOW 1024
+
+/** Opens the first file in the queue of a node and resets its transfer state
+  *
+  * \param node The destination
+  *
+  */
+static void StartFileSend(INT32 node)
+{
+	filetran_t *trans = &transfer[node];
+	filetx_t *f = trans->txlist;
+	trans->mappeddata = NULL;
+
+	// Sending an addon, share it with the other nodes downloading it
+	if (!f->ram && f->wadnum != UINT16_MAX)
+		trans->mappeddata = AcquireSendCache(f->wadnum, f->id.filename, &f->size);
+
+	if (trans->mappeddata)
+		trans->currentfile = (FILE *)1; // Set currentfile to a non-null value to indicate that it is open
+	else if (!f->ram) // Sending a file
+	{
+		long filesize;
+
+		trans->currentfile = fopen(f->id.filename, "rb");
+
+		if (!trans->currentfile)
+			I_Error("File %s does not exist",
+				f->id.filename);
+
+		fseek(trans->currentfile, 0, SEEK_END);
+		filesize = ftell(trans->currentfile);
+
+		// Nobody wants to transfer a file bigger
+		// than 4GB!
+		if (filesize >= LONG_MAX)
+			I_Error("filesize of %s is too large", f->id.filename);
+		if (filesize == -1)
+			I_Error("Error getting filesize of %s", f->id.filename);
+
+		f->size = (UINT32)filesize;
+		fseek(trans->currentfile, 0, SEEK_SET);
+	}
+	else // Sending RAM
+		trans->currentfile = (FILE *)1; // Set currentfile to a non-null value to indicate that it is open
+
+	trans->iteration = 1;
+	trans->ackediteration = 0;
+	trans->position = 0;
+	trans->ackedsize = 0;
+
+	trans->ackedfragments = calloc(f->size / FILEFRAGMENTSIZE + 1, sizeof(*trans->ackedfragments));
+	if (!trans->ackedfragments)
+		I_Error("FileSendTicker: No more memory\n");
+
+	trans->dontsenduntil = 0;
+}
+
+/** Sets up congestion control for the current transfer of a node
+  *
+  * \param node The destination
+  *
+  */
+static void StartCongestionControl(INT32 node)
+{
+	filetran_t *trans = &transfer[node];
+
+	trans->fragmentinfo = calloc(trans->txlist->size / FILEFRAGMENTSIZE + 1, sizeof(*trans->fragmentinfo));
+	if (!trans->fragmentinfo)
+		I_Error("FileSendTicker: No more memory\n");
+
+	// Start from the fixed rate and let acknowledgements open the window
+	trans->inflight = 0;
+	trans->oldestfragment = trans->newestfragment = NOFRAGMENT;
+	trans->senttic = 0;
+	trans->window = cv_downloadspeed.value * FRACUNIT;
+	trans->ssthresh = MAXWINDOW * FRACUNIT;
+	trans->srtt = trans->rttvar = 0;
+	trans->lastloss = 0;
+}
+
+/** Builds and sends the fragment of the current file at the current position of a node
+  *
+  * \param node The destination
+  * \return True if the packet was sent
+  *
+  */
+static boolean SendFileFragment(INT32 node)
+{
+	filetran_t *trans = &transfer[node];
+	filetx_t *f = trans->txlist;
+	filetx_pak *p = &netbuffer->u.filetxpak;
+	size_t fragmentsize = FILEFRAGMENTSIZE;
+
+	netbuffer->packettype = PT_FILEFRAGMENT;
+
+	if (f->size-trans->position < fragmentsize)
+		fragmentsize = f->size-trans->position;
+	if (f->ram)
+		M_Memcpy(p->data, &f->id.ram[trans->position], fragmentsize);
+	else if (trans->mappeddata)
+		M_Memcpy(p->data, &trans->mappeddata[trans->position], fragmentsize);
+	else
+	{
+		fseek(trans->currentfile, trans->position, SEEK_SET);
+
+		if (fread(p->data, 1, fragmentsize, trans->currentfile) != fragmentsize)
+			I_Error("FileSendTicker: can't read %s byte on %s at %d because %s", sizeu1(fragmentsize), f->id.filename, trans->position, M_FileError(trans->currentfile));
+	}
+	p->iteration = trans->iteration;
+	p->position = LONG(trans->position);
+	p->fileid = f->fileid;
+	p->filesize = LONG(f->size);
+	p->size = SHORT((UINT16)FILEFRAGMENTSIZE);
+
+	return HSendPacket(node, false, 0, FILETXHEADER + fragmentsize); // Don't use the default acknowledgement system
+}
+
+/** Moves the position of a node to the next fragment, wrapping around at the end of the file
+  *
+  * \param node The destination
+  *
+  */
+static void AdvanceFilePosition(INT32 node)
+{
+	filetran_t *trans = &transfer[node];
+
+	trans->position += FILEFRAGMENTSIZE;
+	if (trans->position >= trans->txlist->size)
+	{
+		if (trans->ackediteration < trans->iteration)
+			trans->dontsenduntil = I_GetTime() + TICRATE / 2;
+
+		trans->position = 0;
+		trans->iteration++;
+	}
+}
+
+/** Returns how long a congestion-controlled fragment can stay unacknowledged
+  * before it is considered lost
+  *
+  */
+static precise_t GetRetransmitTimeout(filetran_t *trans)
+{
+	const precise_t tic = I_GetPrecisePrecision() / TICRATE;
+
+	// Nothing measured yet, behave like the plain sender
+	if (!trans->srtt)
+		return tic * (TICRATE / 2);
+
+	// The client only acknowledges once per tic, so always allow for that delay
+	return trans->srtt + max(4 * trans->rttvar, 2 * tic);
+}
+
+/** Returns how many fragments a node can be sent in a single tic,
+  * so a full window is spread over a round trip instead of going out at once
+  *
+  */
+static UINT32 GetFragmentsPerTic(filetran_t *trans)
+{
+	const precise_t tic = I_GetPrecisePrecision() / TICRATE;
+	const UINT32 window = trans->window >> FRACBITS;
+	UINT32 rtttics;
+
+	// Nothing measured yet, the window is still the fixed per-tic rate
+	if (!trans->srtt)
+		return max(window, MINWINDOW);
+
+	rtttics = max((UINT32)(trans->srtt / tic), 1);
+	return max((window + rtttics - 1) / rtttics, MINWINDOW);
+}
+
+/** Adds a fragment that was just sent to the end of the in-flight queue of a node
+  *
+  * \param trans The transfer the fragment belongs to
+  * \param fragment The index of the fragment
+  * \param now When it was sent
+  *
+  */
+static void QueueFragment(filetran_t *trans, UINT32 fragment, precise_t now)
+{
+	fragmentinfo_t *info = &trans->fragmentinfo[fragment];
+
+	info->senttime = now;
+	if (info->sends < UINT8_MAX)
+		info->sends++;
+
+	info->prev = trans->newestfragment;
+	info->next = NOFRAGMENT;
+	if (trans->newestfragment != NOFRAGMENT)
+		trans->fragmentinfo[trans->newestfragment].next = fragment;
+	else
+		trans->oldestfragment = fragment;
+	trans->newestfragment = fragment;
+
+	trans->inflight++;
+}
+
+/** Removes an acknowledged or lost fragment from the in-flight queue of a node
+  *
+  * \param trans The transfer the fragment belongs to
+  * \param fragment The index of the fragment
+  *
+  */
+static void UnqueueFragment(filetran_t *trans, UINT32 fragment)
+{
+	fragmentinfo_t *info = &trans->fragmentinfo[fragment];
+
+	if (info->prev != NOFRAGMENT)
+		trans->fragmentinfo[info->prev].next = info->next;
+	else
+		trans->oldestfragment = info->next;
+	if (info->next != NOFRAGMENT)
+		trans->fragmentinfo[info->next].prev = info->prev;
+	else
+		trans->newestfragment = info->prev;
+
+	info->senttime = 0;
+	trans->inflight--;
+}
+
+/** Sends as many fragments to a node as its congestion window allows
+  *
+  * \param node The destination
+  * \return True if the node may still send more this tic
+  *
+  */
+static boolean CongestionFileSend(INT32 node)
+{
+	filetran_t *trans = &transfer[node];
+	const UINT32 numfragments = trans->txlist->size / FILEFRAGMENTSIZE + 1;
+	const precise_t now = I_GetPreciseTime();
+	const precise_t timeout = GetRetransmitTimeout(trans);
+	boolean lost = false;
+
+	// Fragments in flight are queued in the order they were last sent,
+	// so once the oldest one hasn't timed out, none of the others have.
+	// This runs before the window check, or lost fragments filling the
+	// window would never be noticed and the transfer would stall.
+	while (trans->oldestfragment != NOFRAGMENT)
+	{
+		const UINT32 fragment = trans->oldestfragment;
+
+		if (now - trans->fragmentinfo[fragment].senttime < timeout)
+			break;
+
+		// Lost, resend it first and back off at most once per round trip
+		UnqueueFragment(trans, fragment);
+		if (!lost)
+			trans->position = fragment * FILEFRAGMENTSIZE;
+		lost = true;
+
+		if (!trans->lastloss || now - trans->lastloss > max(trans->srtt, I_GetPrecisePrecision() / TICRATE))
+		{
+			trans->ssthresh = max(trans->window / 2, MINWINDOW * FRACUNIT);
+			trans->window = trans->ssthresh;
+			trans->lastloss = now;
+		}
+	}
+
+	if (trans->inflight >= (UINT32)(trans->window >> FRACBITS))
+		return false;
+
+	if (trans->senttic >= GetFragmentsPerTic(trans))
+		return false;
+
+	// Find the next fragment that is neither acknowledged nor in flight
+	for (UINT32 i = 0; i < numfragments; i++)
+	{
+		const UINT32 fragment = trans->position / FILEFRAGMENTSIZE;
+
+		if (!trans->ackedfragments[fragment] && !trans->fragmentinfo[fragment].senttime)
+		{
+			if (!SendFileFragment(node))
+				return false;
+
+			QueueFragment(trans, fragment, now);
+			trans->senttic++;
+
+			AdvanceFilePosition(node);
+			return true;
+		}
+
+		AdvanceFilePosition(node);
+	}
+
+	// Everything is acknowledged or in flight, wait for acknowledgements
+	return false;
+}
+
+/** Updates the round-trip estimate and congestion window of a node
+  * when one of its fragments has been acknowledged
+  *
+  * \param trans The transfer the fragment belongs to
+  * \param fragment The index of the acknowledged fragment
+  *
+  */
+static void CongestionFileAck(filetran_t *trans, UINT32 fragment)
+{
+	fragmentinfo_t *info = &trans->fragmentinfo[fragment];
+
+	if (!info->senttime)
+		return; // Already considered lost, nothing to account for
+
+	// Retransmitted fragments give ambiguous samples
+	if (info->sends == 1)
+	{
+		const precise_t rtt = I_GetPreciseTime() - info->senttime;
+
+		if (!trans->srtt)
+		{
+			trans->srtt = rtt;
+			trans->rttvar = rtt / 2;
+		}
+		else
+		{
+			const precise_t delta = rtt > trans->srtt ? rtt - trans->srtt : trans->srtt - rtt;
+			trans->rttvar = (3 * trans->rttvar + delta) / 4;
+			trans->srtt = (7 * trans->srtt + rtt) / 8;
+		}
+	}
+
+	UnqueueFragment(trans, fragment);
+
+	// Slow start, then additive increase
+	if (trans->window < trans->ssthresh)
+		trans->window += FRACUNIT;
+	else
+		trans->window += FixedDiv(FRACUNIT, trans->window);
+
+	trans->window = min(trans->window, MAXWINDOW * FRACUNIT);
+}
+
 /** Handles file transmission
   *
   */
 void FileSendTicker(void)
 {
 	static INT32 currentnode = 0;
-	filetx_pak *p;
-	size_t fragmentsize;
-	filetx_t *f;
-	INT32 packetsent, ram, i, j;
+	INT32 packetsent, i, j;
 
 	// If someone is taking too long to download, kick them with a timeout
 	// to prevent blocking the rest of the server...
@@ -1031,9 +1527,38 @@ void FileSendTicker(void)
 	if (!filestosend) // No file to send
 		return;
 
-	packetsent = cv_downloadspeed.value;
+	if (cv_downloadcongestion.value)
+	{
+		boolean sent = true;
 
-	netbuffer->packettype = PT_FILEFRAGMENT;
+		for (i = 0; i < MAXNETNODES; i++)
+			transfer[i].senttic = 0;
+
+		// Give one fragment to each node in turn until every window is full,
+		// so a fast link doesn't delay the others
+		while (sent)
+		{
+			sent = false;
+
+			for (i = 0; i < MAXNETNODES; i++)
+			{
+				if (!transfer[i].txlist)
+					continue;
+
+				if (!transfer[i].currentfile)
+					StartFileSend(i);
+				if (!transfer[i].fragmentinfo)
+					StartCongestionControl(i);
+
+				if (CongestionFileSend(i))
+					sent = true;
+			}
+		}
+
+		return;
+	}
+
+	packetsent = cv_downloadspeed.value;
 
 	while (packetsent-- && filestosend != 0)
 	{
@@ -1048,50 +1573,10 @@ void FileSendTicker(void)
 			I_Error("filestosend=%d but no file to send found\n", filestosend);
 
 		currentnode = (i+1) % MAXNETNODES;
-		f = transfer[i].txlist;
-		ram = f->ram;
 
-		// Open the file if it isn't open yet, or
+		// Open the file if it isn't open yet
 		if (!transfer[i].currentfile)
-		{
-			if (!ram) // Sending a file
-			{
-				long filesize;
-
-				transfer[i].currentfile =
-					fopen(f->id.filename, "rb");
-
-				if (!transfer[i].currentfile)
-					I_Error("File %s does not exist",
-						f->id.filename);
-
-				fseek(transfer[i].currentfile, 0, SEEK_END);
-				filesize = ftell(transfer[i].currentfile);
-
-				// Nobody wants to transfer a file bigger
-				// than 4GB!
-				if (filesize >= LONG_MAX)
-					I_Error("filesize of %s is too large", f->id.filename);
-				if (filesize == -1)
-					I_Error("Error getting filesize of %s", f->id.filename);
-
-				f->size = (UINT32)filesize;
-				fseek(transfer[i].currentfile, 0, SEEK_SET);
-			}
-			else // Sending RAM
-				transfer[i].currentfile = (FILE *)1; // Set currentfile to a non-null value to indicate that it is open
-
-			transfer[i].iteration = 1;
-			transfer[i].ackediteration = 0;
-			transfer[i].position = 0;
-			transfer[i].ackedsize = 0;
-
-			transfer[i].ackedfragments = calloc(f->size / FILEFRAGMENTSIZE + 1, sizeof(*transfer[i].ackedfragments));
-			if (!transfer[i].ackedfragments)
-				I_Error("FileSendTicker: No more memory\n");
-
-			transfer[i].dontsenduntil = 0;
-		}
+			StartFileSend(i);
 
 		// If the client hasn't acknowledged any fragment from the previous iteration,
 		// it is most likely because their acks haven't had enough time to reach the server
@@ -1101,51 +1586,11 @@ void FileSendTicker(void)
 
 		// Find the first non-acknowledged fragment
 		while (transfer[i].ackedfragments[transfer[i].position / FILEFRAGMENTSIZE])
-		{
-			transfer[i].position += FILEFRAGMENTSIZE;
-			if (transfer[i].position >= f->size)
-			{
-				if (transfer[i].ackediteration < transfer[i].iteration)
-					transfer[i].dontsenduntil = I_GetTime() + TICRATE / 2;
-
-				transfer[i].position = 0;
-				transfer[i].iteration++;
-			}
-		}
-
-		// Build a packet containing a file fragment
-		p = &netbuffer->u.filetxpak;
-		fragmentsize = FILEFRAGMENTSIZE;
-		if (f->size-transfer[i].position < fragmentsize)
-			fragmentsize = f->size-transfer[i].position;
-		if (ram)
-			M_Memcpy(p->data, &f->id.ram[transfer[i].position], fragmentsize);
-		else
-		{
-			fseek(transfer[i].currentfile, transfer[i].position, SEEK_SET);
-
-			if (fread(p->data, 1, fragmentsize, transfer[i].currentfile) != fragmentsize)
-				I_Error("FileSendTicker: can't read %s byte on %s at %d because %s", sizeu1(fragmentsize), f->id.filename, transfer[i].position, M_FileError(transfer[i].currentfile));
-		}
-		p->iteration = transfer[i].iteration;
-		p->position = LONG(transfer[i].position);
-		p->fileid = f->fileid;
-		p->filesize = LONG(f->size);
-		p->size = SHORT((UINT16)FILEFRAGMENTSIZE);
+			AdvanceFilePosition(i);
 
 		// Send the packet
-		if (HSendPacket(i, false, 0, FILETXHEADER + fragmentsize)) // Don't use the default acknowledgement system
-		{ // Success
-			transfer[i].position = (UINT32)(transfer[i].position + fragmentsize);
-			if (transfer[i].position >= f->size)
-			{
-				if (transfer[i].ackediteration < transfer[i].iteration)
-					transfer[i].dontsenduntil = I_GetTime() + TICRATE / 2;
-
-				transfer[i].position = 0;
-				transfer[i].iteration++;
-			}
-		}
+		if (SendFileFragment(i))
+			AdvanceFilePosition(i);
 		else
 		{ // Not sent for some odd reason, retry at next call
 			// Exit the while (can't send this one so why should i send the next?)
@@ -1186,7 +1631,7 @@ void PT_FileAck(SINT8 node)
 		for (INT32 j = 0; j < 32; j++)
 			if (LONG(segment->acks) & (1 << j))
 			{
-				if (LONG(segment->start) * FILEFRAGMENTSIZE >= trans->txlist->size)
+				if ((LONG(segment->start) + j) * FILEFRAGMENTSIZE >= trans->txlist->size)
 				{
 					Net_CloseConnection(node);
 					return;
@@ -1194,11 +1639,14 @@ void PT_FileAck(SINT8 node)
 
 				if (!trans->ackedfragments[LONG(segment->start) + j])
 				{
+					if (trans->fragmentinfo)
+						CongestionFileAck(trans, LONG(segment->start) + j);
+
 					trans->ackedfragments[LONG(segment->start) + j] = true;
 					trans->ackedsize += FILEFRAGMENTSIZE;
 
 					// If the last missing fragment was acked, finish!
-					if (trans->ackedsize == trans->txlist->size)
+					if (trans->ackedsize >= trans->txlist->size)
 					{
 						SV_EndFileSend(node);
 						return;
@@ -114,7 +114,7 @@ extern struct HTTP_login
 }
 *curl_logins;
 
-extern consvar_t cv_maxsend, cv_noticedownload, cv_downloadspeed;
+extern consvar_t cv_maxsend, cv_noticedownload, cv_downloadspeed, cv_downloadcongestion;
 
 void AllocFileNeeded(INT32 size);
 void FreeFileNeeded(void);
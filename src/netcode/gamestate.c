@@ -57,6 +57,7 @@ void SV_SendSaveGame(INT32 node, boolean resending)
 	save_t savebuffer;
 	UINT8 *compressedsave;
 	UINT8 *buffertosend;
+	INT32 numtasks;
 
 	// first save it in a malloced buffer
 	savebuffer.size = SAVEGAMESIZE;
@@ -70,6 +71,10 @@ void SV_SendSaveGame(INT32 node, boolean resending)
 	// Leave room for the uncompressed length.
 	savebuffer.pos = sizeof(UINT32);
 
+	// Lua tasks can't be archived, so the joiner starts without them
+	if ((numtasks = LUA_NumTasks()))
+		CONS_Alert(CONS_WARNING, M_GetText("%d Lua tasks are running and won't be sent to the joining player, who may desync.\n"), numtasks);
+
 	P_SaveNetGame(&savebuffer, resending);
 
 	length = savebuffer.pos;
@@ -26,7 +26,7 @@ packet versions.
 If you change the struct or the meaning of a field
 therein, increment this number.
 */
-#define PACKETVERSION 5
+#define PACKETVERSION 6
 
 // Network play related stuff.
 // There is a data struct that stores network
@@ -294,7 +294,7 @@ typedef struct
 	UINT8 ackreturn; // The return of the ack number
 
 	UINT8 packettype;
-	UINT8 reserved; // Padding
+	UINT8 acksbitmap; // Bit n is set if ackreturn + n + 1 was received too
 	union
 	{
 		clientcmd_pak clientpak;
@@ -23,6 +23,7 @@
 #include "../byteptr.h"
 #include "../doomstat.h"
 #include "../doomtype.h"
+#include "../m_fixed.h"
 
 tic_t firstticstosend; // Smallest netnode.tic
 tic_t tictoclear = 0; // Optimize D_ClearTiccmd
@@ -31,6 +32,30 @@ ticcmd_t localcmds2;
 boolean cl_packetmissed;
 ticcmd_t netcmds[BACKUPTICS][MAXPLAYERS];
 
+#define JITTERBUFFERSIZE (MAXJITTERBUFFER + 2)
+
+typedef struct
+{
+	ticcmd_t cmd;
+	ticcmd_t cmd2; // Splitscreen
+	boolean hascmd2;
+} bufferedcmd_t;
+
+// Input received from a node but not used yet (cv_jitterbuffer)
+typedef struct
+{
+	bufferedcmd_t cmds[JITTERBUFFERSIZE];
+	UINT8 tail;
+	UINT8 count;
+	UINT8 target; // Number of tics to keep in advance, from the measured jitter
+	boolean refilling; // Ran out of input, wait until there is enough again
+	fixed_t jitter; // Smoothed deviation of the arrival times, in tics
+	precise_t lastarrival;
+	tic_t lastclienttic;
+} jitterbuffer_t;
+
+static jitterbuffer_t jitterbuffers[MAXNETNODES];
+
 static inline void *G_DcpyTiccmd(void* dest, const ticcmd_t* src, const size_t n)
 {
 	const size_t d = n / sizeof(ticcmd_t);
@@ -100,9 +125,8 @@ void D_ResetTiccmds(void)
 }
 
 // Check ticcmd for "speed hacks"
-static void CheckTiccmdHacks(INT32 playernum, tic_t tic)
+static void CheckTiccmdHacks(INT32 playernum, ticcmd_t *cmd)
 {
-	ticcmd_t *cmd = &netcmds[tic%BACKUPTICS][playernum];
 	if (cmd->forwardmove > MAXPLMOVE || cmd->forwardmove < -MAXPLMOVE
 		|| cmd->sidemove > MAXPLMOVE || cmd->sidemove < -MAXPLMOVE)
 	{
@@ -148,6 +172,118 @@ static void CheckConsistancy(SINT8 nodenum, tic_t tic)
 	}
 }
 
+void SV_ResetJitterBuffer(INT32 node)
+{
+	memset(&jitterbuffers[node], 0, sizeof(jitterbuffers[node]));
+}
+
+// Drops the oldest buffered input, keeping its buttons so no press gets lost
+static void DropBufferedCmd(jitterbuffer_t *jb)
+{
+	bufferedcmd_t *oldest = &jb->cmds[jb->tail];
+
+	jb->tail = (jb->tail + 1) % JITTERBUFFERSIZE;
+	jb->count--;
+
+	if (jb->count)
+	{
+		bufferedcmd_t *next = &jb->cmds[jb->tail];
+		next->cmd.buttons |= oldest->cmd.buttons;
+		next->cmd2.buttons |= oldest->cmd2.buttons;
+	}
+}
+
+/** Measures how irregularly the input of a node arrives and queues it
+  *
+  * \param nodenum The node the input comes from
+  * \param netconsole The player of the node
+  * \param clienttic The tic the client was at when it sent the input
+  *
+  */
+static void BufferClientCmd(SINT8 nodenum, INT32 netconsole, tic_t clienttic)
+{
+	jitterbuffer_t *jb = &jitterbuffers[nodenum];
+	const precise_t now = I_GetPreciseTime();
+	bufferedcmd_t *buffered;
+
+	if (jb->lastarrival && clienttic > jb->lastclienttic)
+	{
+		// Interarrival jitter, like RTP: how much later or earlier than
+		// the client tics suggest did this arrive?
+		const precise_t elapsed = min(now - jb->lastarrival, I_GetPrecisePrecision());
+		const INT64 actual = (INT64)(elapsed * TICRATE * FRACUNIT / I_GetPrecisePrecision());
+		const INT64 expected = (INT64)(clienttic - jb->lastclienttic) * FRACUNIT;
+		const INT64 deviation = actual > expected ? actual - expected : expected - actual;
+
+		jb->jitter += (fixed_t)((min(deviation, MAXJITTERBUFFER * FRACUNIT) - jb->jitter) / 16);
+	}
+
+	if (clienttic >= jb->lastclienttic || !jb->lastarrival)
+	{
+		jb->lastarrival = now;
+		jb->lastclienttic = clienttic;
+	}
+
+	// Enough buffer to cover twice the average deviation
+	jb->target = (UINT8)min((jb->jitter * 2 + FRACUNIT - 1) >> FRACBITS, cv_jitterbuffer.value);
+
+	if (jb->count == JITTERBUFFERSIZE)
+		DropBufferedCmd(jb);
+
+	buffered = &jb->cmds[(jb->tail + jb->count) % JITTERBUFFERSIZE];
+	G_MoveTiccmd(&buffered->cmd, &netbuffer->u.clientpak.cmd, 1);
+
+	// Splitscreen cmd
+	buffered->hascmd2 = (netbuffer->packettype == PT_CLIENT2CMD || netbuffer->packettype == PT_CLIENT2MIS)
+		&& netnodes[nodenum].player2 >= 0;
+	if (buffered->hascmd2)
+		G_MoveTiccmd(&buffered->cmd2, &netbuffer->u.client2pak.cmd2, 1);
+	else
+		memset(&buffered->cmd2, 0, sizeof(buffered->cmd2));
+
+	jb->count++;
+
+	CheckTiccmdHacks(netconsole, &buffered->cmd);
+}
+
+/** Gives the next buffered input of a node to the tic being made
+  * If there is none, SV_Maketic repeats the previous one
+  *
+  * \param nodenum The node to take the input from
+  *
+  */
+static void PlayBufferedCmd(INT32 nodenum)
+{
+	jitterbuffer_t *jb = &jitterbuffers[nodenum];
+	netnode_t *node = &netnodes[nodenum];
+	bufferedcmd_t *buffered;
+
+	// The client is further ahead than it needs to be, catch up
+	while (jb->count > jb->target + 1)
+		DropBufferedCmd(jb);
+
+	if (!jb->count)
+	{
+		jb->refilling = true;
+		return;
+	}
+
+	if (jb->refilling)
+	{
+		if (jb->count <= jb->target)
+			return;
+		jb->refilling = false;
+	}
+
+	buffered = &jb->cmds[jb->tail];
+	jb->tail = (jb->tail + 1) % JITTERBUFFERSIZE;
+	jb->count--;
+
+	G_MoveTiccmd(&netcmds[maketic % BACKUPTICS][node->player], &buffered->cmd, 1);
+	if (buffered->hascmd2 && node->player2 >= 0)
+		G_MoveTiccmd(&netcmds[maketic % BACKUPTICS][(UINT8)node->player2], &buffered->cmd2, 1);
+}
+
 void PT_ClientCmd(SINT8 nodenum, INT32 netconsole)
 {
 	netnode_t *node = &netnodes[nodenum];
@@ -162,11 +298,13 @@ void PT_ClientCmd(SINT8 nodenum, INT32 netconsole)
 	realend = ExpandTics(netbuffer->u.clientpak.resendfrom, nodenum);
 
 	if (netbuffer->packettype == PT_CLIENTMIS || netbuffer->packettype == PT_CLIENT2MIS
-		|| netbuffer->packettype == PT_NODEKEEPALIVEMIS
-		|| node->supposedtic < realend)
+		|| netbuffer->packettype == PT_NODEKEEPALIVEMIS)
 	{
 		node->supposedtic = realend;
+		Net_CountResendFrom(nodenum);
 	}
+	else if (node->supposedtic < realend)
+		node->supposedtic = realend;
 	// Discard out of order packet
 	if (node->tic > realend)
 	{
@@ -191,6 +329,14 @@ void PT_ClientCmd(SINT8 nodenum, INT32 netconsole)
 		|| netbuffer->packettype == PT_NODEKEEPALIVEMIS)
 		return;
 
+	// Let SV_Maketic pick the input at a steady pace
+	if (cv_jitterbuffer.value)
+	{
+		BufferClientCmd(nodenum, netconsole, realstart);
+		CheckConsistancy(nodenum, realstart);
+		return;
+	}
+
 	// If we've alredy received a ticcmd for this tic, just submit it for the next one.
 	tic_t faketic = maketic;
 	if ((!!(netcmds[maketic % BACKUPTICS][netconsole].angleturn & TICCMD_RECEIVED))
@@ -206,7 +352,7 @@ void PT_ClientCmd(SINT8 nodenum, INT32 netconsole)
 		G_MoveTiccmd(&netcmds[faketic%BACKUPTICS][(UINT8)node->player2],
 			&netbuffer->u.client2pak.cmd2, 1);
 
-	CheckTiccmdHacks(netconsole, faketic);
+	CheckTiccmdHacks(netconsole, &netcmds[faketic%BACKUPTICS][netconsole]);
 	CheckConsistancy(nodenum, realstart);
 }
 
@@ -437,6 +583,13 @@ void Local_Maketic(INT32 realtics)
 // create missed tic
 void SV_Maketic(void)
 {
+	if (cv_jitterbuffer.value)
+	{
+		for (INT32 i = 0; i < MAXNETNODES; i++)
+			if (netnodes[i].ingame && netnodes[i].player >= 0)
+				PlayBufferedCmd(i);
+	}
+
 	for (INT32 i = 0; i < MAXPLAYERS; i++)
 	{
 		if (!playeringame[i])
@@ -18,6 +18,8 @@
 #include "../doomdef.h"
 #include "../doomtype.h"
 
+#define MAXJITTERBUFFER 4 // Tics of input the server can hold back for one node
+
 extern tic_t firstticstosend; // min of the nettics
 extern tic_t tictoclear; // optimize d_clearticcmd
 
@@ -40,5 +42,6 @@ void CL_SendClientCmd(void);
 void SV_SendTics(void);
 void Local_Maketic(INT32 realtics);
 void SV_Maketic(void);
+void SV_ResetJitterBuffer(INT32 node);
 
 #endif
@@ -37,6 +37,7 @@ result_e T_MovePlane(sector_t *sector, fixed_t speed, fixed_t dest, boolean crus
 	fixed_t lastpos;
 	fixed_t destheight; // used to keep floors/ceilings from moving through each other
 	sector->moved = true;
+	P_InvalidateFOFHeights();
 
 	if (ceiling)
 	{
@@ -336,6 +337,7 @@ void T_MoveElevator(elevator_t *elevator)
 			res = crushed;
 			elevator->sector->floorheight = oldfloor;
 			elevator->sector->ceilingheight = oldceiling;
+			P_InvalidateFOFHeights();
 		}
 		else
 			res = res1;
@@ -401,6 +403,7 @@ void T_MoveElevator(elevator_t *elevator)
 			res = crushed;
 			elevator->sector->floorheight = oldfloor;
 			elevator->sector->ceilingheight = oldceiling;
+			P_InvalidateFOFHeights();
 		}
 		else
 			res = res1;
@@ -524,6 +527,7 @@ void T_ContinuousFalling(continuousfall_t *faller)
 	{
 		faller->sector->ceilingheight = faller->ceilingstartheight;
 		faller->sector->floorheight = faller->floorstartheight;
+		P_InvalidateFOFHeights();
 
 		R_ClearLevelInterpolatorState(&faller->thinker);
 	}
@@ -873,6 +877,7 @@ void T_StartCrumble(crumble_t *crumble)
 		crumble->sector->crumblestate = CRUMBLE_WAIT;
 		crumble->sector->ceilingheight = crumble->ceilingwasheight;
 		crumble->sector->floorheight = crumble->floorwasheight;
+		P_InvalidateFOFHeights();
 		crumble->sector->floordata = NULL;
 		crumble->sector->ceilingdata = NULL;
 		crumble->sector->ceilspeed = 0;
@@ -924,6 +929,7 @@ void T_MarioBlock(mariothink_t *block)
 	{
 		block->sector->ceilingheight = block->ceilingstartheight;
 		block->sector->floorheight = block->floorstartheight;
+		P_InvalidateFOFHeights();
 		P_RemoveThinker(&block->thinker);
 		block->sector->floordata = NULL;
 		block->sector->ceilingdata = NULL;
@@ -1449,6 +1455,7 @@ void T_RaiseSector(raise_t *raise)
 		raise->sector->ceilingheight = ceilingdestination;
 		raise->sector->ceilspeed = 0;
 		raise->sector->floorspeed = 0;
+		P_InvalidateFOFHeights();
 		return;
 	}
 	direction = moveUp ? 1 : -1;
@@ -1954,6 +1961,9 @@ void EV_CrumbleChain(sector_t *sec, ffloor_t *rover)
 	// no longer exists (can't collide with again)
 	rover->fofflags &= ~FOF_EXISTS;
 	rover->master->frontsector->moved = true;
+	P_InvalidateSightCache();
+	P_InvalidateFOFHeights();
+	P_WakeAllMobjs();
 	T_UpdateMobjPlaneZ(sec); // prevent objects from floating
 	P_RecalcPrecipInSector(sec);
 }
@@ -2518,6 +2518,8 @@ void P_KillMobj(mobj_t *target, mobj_t *inflictor, mobj_t *source, UINT8 damaget
 {
 	mobj_t *mo;
 
+	P_WakeMobj(target);
+
 	if (inflictor && (inflictor->type == MT_SHELL || inflictor->type == MT_FIREBALL))
 		S_StartScreamSound(target, sfx_mario2);
 
@@ -3690,6 +3692,8 @@ boolean P_DamageMobj(mobj_t *target, mobj_t *inflictor, mobj_t *source, INT32 da
 	if (target->health <= 0)
 		return false;
 
+	P_WakeMobj(target);
+
 	// Spectator handling
 	if (multiplayer)
 	{
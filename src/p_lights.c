@@ -240,29 +240,48 @@ strobe_t *P_SpawnAdjustableStrobeFlash(sector_t *sector, INT16 lighta, INT16 lig
   * \sa P_SpawnAdjustableGlowingLight
   */
 void T_Glow(glow_t *g)
+{
+	thinkerresult_t *res = P_GetThinkerResult(&g->thinker, g->sector->lightlevel);
+
+	if (res)
+		g->sector->lightlevel = (INT16)res->out[0];
+	else
+		g->sector->lightlevel = P_StepGlow(g, g->sector->lightlevel);
+}
+
+/** Advances a glowing light by one tic.
+  * Only touches the glow itself, so it may run ahead of time in parallel.
+  *
+  * \param g          Action structure for this effect.
+  * \param lightlevel The sector's current light level.
+  * \return The sector's new light level.
+  */
+INT16 P_StepGlow(glow_t *g, INT16 lightlevel)
 {
 	switch (g->direction)
 	{
 		case -1:
 			// DOWN
-			g->sector->lightlevel -= g->speed;
-			if (g->sector->lightlevel <= g->minlight)
+			lightlevel -= g->speed;
+			if (lightlevel <= g->minlight)
 			{
-				g->sector->lightlevel += g->speed;
+				lightlevel += g->speed;
 				g->direction = 1;
 			}
 			break;
 
 		case 1:
 			// UP
-			g->sector->lightlevel += g->speed;
-			if (g->sector->lightlevel >= g->maxlight)
+			lightlevel += g->speed;
+			if (lightlevel >= g->maxlight)
 			{
-				g->sector->lightlevel -= g->speed;
+				lightlevel -= g->speed;
 				g->direction = -1;
 			}
 			break;
 	}
+
+	return lightlevel;
 }
 
 /** Spawns an adjustable glowing light effect in a sector.
@@ -387,13 +406,40 @@ void P_FadeLight(INT16 tag, INT32 destvalue, INT32 speed, boolean ticbased, bool
   */
 void T_LightFade(lightlevel_t *ll)
 {
-	if (--ll->timer <= 0)
+	thinkerresult_t *res = P_GetThinkerResult(&ll->thinker, 0);
+	INT16 level;
+	boolean finished;
+
+	if (res)
 	{
-		ll->sector->lightlevel = ll->destlevel; // set to dest lightlevel
+		level = (INT16)res->out[0];
+		finished = res->finished;
+	}
+	else
+		finished = P_StepLightFade(ll, &level);
+
+	ll->sector->lightlevel = level;
+
+	if (finished)
 		P_RemoveLighting(ll->sector); // clear lightingdata, remove thinker
-		return;
+}
+
+/** Advances a light fade by one tic.
+  * Only touches the fade itself, so it may run ahead of time in parallel.
+  *
+  * \param ll    Thinker structure for this light level fade.
+  * \param level Set to the sector's new light level.
+  * \return True if the fade is over and should be removed.
+  */
+boolean P_StepLightFade(lightlevel_t *ll, INT16 *level)
+{
+	if (--ll->timer <= 0)
+	{
+		*level = ll->destlevel; // set to dest lightlevel
+		return true;
 	}
 
 	ll->fixedcurlevel = ll->fixedcurlevel + ll->fixedpertic;
-	ll->sector->lightlevel = (ll->fixedcurlevel)>>FRACBITS;
+	*level = (ll->fixedcurlevel)>>FRACBITS;
+	return false;
 }
@@ -307,6 +307,15 @@ FUNCINLINE static ATTRINLINE boolean P_MobjWasRemoved(mobj_t *mobj)
 	return mobj == NULL || mobj->thinker.function != (actionf_p1)P_MobjThinker;
 }
 
+// Makes a sleeping mobj (cv_sleepmobjs) think again from its next turn on.
+// Call this for anything that could make an idle mobj do something.
+FUNCINLINE static ATTRINLINE void P_WakeMobj(mobj_t *mobj)
+{
+	mobj->eflags &= ~MFE_SLEEPING;
+}
+
+void P_WakeAllMobjs(void);
+
 fixed_t P_MobjFloorZ(sector_t *sector, sector_t *boundsec, fixed_t x, fixed_t y, fixed_t radius, line_t *line, boolean lowest, boolean perfect);
 fixed_t P_MobjCeilingZ(sector_t *sector, sector_t *boundsec, fixed_t x, fixed_t y, fixed_t radius, line_t *line, boolean lowest, boolean perfect);
 #define P_GetFloorZ(mobj, sector, x, y, line) P_MobjFloorZ(sector, NULL, x, y, mobj->radius, line, false, false)
@@ -425,6 +434,8 @@ boolean P_LineIsBlocking(mobj_t *mo, line_t *li);
 void P_SlideMove(mobj_t *mo);
 void P_BounceMove(mobj_t *mo);
 boolean P_CheckSight(mobj_t *t1, mobj_t *t2);
+void P_InvalidateSightCache(void);
+void P_SetSightCacheActive(boolean active);
 void P_CheckHoopPosition(mobj_t *hoopthing, fixed_t x, fixed_t y, fixed_t z, fixed_t radius);
 
 boolean P_CheckSector(sector_t *sector, boolean crunch);
@@ -437,6 +448,7 @@ void P_Initsecnode(void);
 
 void P_RadiusAttack(mobj_t *spot, mobj_t *source, fixed_t damagedist, UINT8 damagetype, boolean sightcheck);
 
+void P_InvalidateFOFHeights(void);
 fixed_t P_FloorzAtPos(fixed_t x, fixed_t y, fixed_t z, fixed_t height);
 fixed_t P_CeilingzAtPos(fixed_t x, fixed_t y, fixed_t z, fixed_t height);
 boolean PIT_PushableMoved(mobj_t *thing);
@@ -453,6 +465,7 @@ extracolormap_t *P_GetSectorColormapAt(fixed_t x, fixed_t y, fixed_t z);
 // P_SETUP
 //
 extern UINT8 *rejectmatrix; // for fast sight rejection
+extern INT32 *rejectgroups; // generated instead of rejectmatrix
 extern INT32 *blockmaplump; // offsets in blockmap are from here
 extern INT32 *blockmap; // Big blockmap
 extern INT32 bmapwidth;
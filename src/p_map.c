@@ -45,6 +45,8 @@ static INT32 tmflags;
 fixed_t tmx;
 fixed_t tmy;
 
+static mobj_t *tmsweptthing; // mover whose steps can skip the thing scan, see increment_move
+
 static precipmobj_t *tmprecipthing;
 static fixed_t preciptmbbox[4];
 
@@ -2257,7 +2259,7 @@ boolean P_CheckPosition(mobj_t *thing, fixed_t x, fixed_t y)
 		return true;
 
 	// Check things first.
-	if (!(thing->flags & MF_NOCLIPTHING))
+	if (!(thing->flags & MF_NOCLIPTHING) && thing != tmsweptthing)
 	{
 		for (bx = xl; bx <= xh; bx++)
 			for (by = yl; by <= yh; by++)
@@ -2662,8 +2664,98 @@ boolean PIT_PushableMoved(mobj_t *thing)
 	return true;
 }
 
+//
+// Swept move broadphase
+//
+// increment_move checks a long move one radius-sized step at a time. Before
+// the steps are taken, the blockmap cells covering the whole move are
+// scanned once; if no thing in them comes near the swept box, every step's
+// thing scan in P_CheckPosition would only ever find nothing, so it is
+// skipped. The steps themselves, and the order of any collision side
+// effects, are untouched.
+//
+static fixed_t sweptbox[4];
+
+static boolean PIT_SweptThing(mobj_t *thing)
+{
+	fixed_t blockdist, dx, dy;
+
+	if (thing == tmthing)
+		return true;
+
+	blockdist = thing->radius + tmthing->radius;
+
+	if (thing->x < sweptbox[BOXLEFT])
+		dx = sweptbox[BOXLEFT] - thing->x;
+	else if (thing->x > sweptbox[BOXRIGHT])
+		dx = thing->x - sweptbox[BOXRIGHT];
+	else
+		dx = 0;
+
+	if (thing->y < sweptbox[BOXBOTTOM])
+		dy = sweptbox[BOXBOTTOM] - thing->y;
+	else if (thing->y > sweptbox[BOXTOP])
+		dy = thing->y - sweptbox[BOXTOP];
+	else
+		dy = 0;
+
+	// Same distance test PIT_DoCheckThing gates every interaction behind
+	return (dx >= blockdist || dy >= blockdist);
+}
+
+/** Checks whether a move from a mobj's position to (x, y) can pass near
+  * any other thing at all.
+  *
+  * \param thing The mobj about to move.
+  * \param x     Destination x.
+  * \param y     Destination y.
+  * \return True if no thing in the blockmap cells covered by the move could
+  *         be touched by any of its steps.
+  */
+static boolean P_SweptMoveIsClear(mobj_t *thing, fixed_t x, fixed_t y)
+{
+	INT32 xl, xh, yl, yh, bx, by;
+	boolean clear = true;
+
+	if (thing->flags & MF_NOCLIPTHING)
+		return false;
+
+	// A line collide hook could spawn or move things between steps
+	if (LUA_MobjHookAvailable(thing->type, MOBJ_HOOK(MobjLineCollide)))
+		return false;
+
+	sweptbox[BOXLEFT] = min(thing->x, x);
+	sweptbox[BOXRIGHT] = max(thing->x, x);
+	sweptbox[BOXBOTTOM] = min(thing->y, y);
+	sweptbox[BOXTOP] = max(thing->y, y);
+
+	// The union of the cells every step of the move would scan
+	xl = (sweptbox[BOXLEFT] - thing->radius - bmaporgx)>>MAPBLOCKSHIFT;
+	xh = (sweptbox[BOXRIGHT] + thing->radius - bmaporgx)>>MAPBLOCKSHIFT;
+	yl = (sweptbox[BOXBOTTOM] - thing->radius - bmaporgy)>>MAPBLOCKSHIFT;
+	yh = (sweptbox[BOXTOP] + thing->radius - bmaporgy)>>MAPBLOCKSHIFT;
+
+	if (xl < 0)
+		xl = 0;
+	if (yl < 0)
+		yl = 0;
+	if (xh >= bmapwidth)
+		xh = bmapwidth - 1;
+	if (yh >= bmapheight)
+		yh = bmapheight - 1;
+
+	P_SetTarget(&tmthing, thing);
+
+	for (bx = xl; bx <= xh && clear; bx++)
+		for (by = yl; by <= yh && clear; by++)
+			if (!P_BlockThingsIterator(bx, by, PIT_SweptThing))
+				clear = false;
+
+	return clear;
+}
+
 static boolean
-increment_move
+increment_move_steps
 (		mobj_t * thing,
 		fixed_t x,
 		fixed_t y,
@@ -2827,6 +2919,30 @@ increment_move
 	return true;
 }
 
+static boolean
+increment_move
+(		mobj_t * thing,
+		fixed_t x,
+		fixed_t y,
+		boolean allowdropoff)
+{
+	mobj_t *oldsweptthing = tmsweptthing;
+	boolean moveok;
+
+	// Only worth it when the move takes more than one step
+	if (!(thing->flags & MF_NOCLIP)
+	&& (abs(x - thing->x) > thing->radius || abs(y - thing->y) > thing->radius)
+	&& P_SweptMoveIsClear(thing, x, y))
+		tmsweptthing = thing;
+	else
+		tmsweptthing = NULL;
+
+	moveok = increment_move_steps(thing, x, y, allowdropoff);
+	tmsweptthing = oldsweptthing;
+
+	return moveok;
+}
+
 //
 // P_CheckMove
 // Check if a P_TryMove would be successful.
@@ -4249,6 +4365,8 @@ static boolean PIT_ChangeSector(mobj_t *thing, boolean realcrush, boolean crunch
 	//If a thing is both pushable and vulnerable, it doesn't block the crusher because it gets killed.
 	boolean immunepushable = ((thing->flags & (MF_PUSHABLE | MF_SHOOTABLE)) == MF_PUSHABLE);
 
+	P_WakeMobj(thing); // the floor or ceiling around it moved
+
 	if (P_ThingHeightClip(thing))
 	{
 		//thing fits, check next thing
@@ -4485,6 +4603,10 @@ boolean P_CheckSector(sector_t *sector, boolean crunch)
 	//
 	// killough 4/7/98: simplified to avoid using complicated counter
 
+	// The sector's planes have just moved, so old sight checks and FOF heights are void.
+	P_InvalidateSightCache();
+	P_InvalidateFOFHeights();
+
 	// First, let's see if anything will keep it from crushing.
 	if (!P_CheckSectorHelper(sector, false, crunch))
 		return true;
@@ -4511,18 +4633,30 @@ void P_Initsecnode(void)
 
 // P_GetSecnode() retrieves a node from the freelist. The calling routine
 // should make sure it sets all fields properly.
+//
+// When the freelist runs dry it is refilled with a whole block of nodes
+// at once, so nodes sit next to each other in memory instead of each one
+// being its own zone allocation.
+
+#define SECNODEBLOCK 256
 
 static msecnode_t *P_GetSecnode(void)
 {
 	msecnode_t *node;
 
-	if (headsecnode)
+	if (!headsecnode)
 	{
-		node = headsecnode;
-		headsecnode = headsecnode->m_thinglist_next;
+		msecnode_t *block = Z_Calloc(SECNODEBLOCK * sizeof (*block), PU_LEVEL, NULL);
+		size_t i;
+
+		for (i = 0; i < SECNODEBLOCK - 1; i++)
+			block[i].m_thinglist_next = &block[i+1];
+		block[SECNODEBLOCK - 1].m_thinglist_next = NULL;
+		headsecnode = block;
 	}
-	else
-		node = Z_Calloc(sizeof (*node), PU_LEVEL, NULL);
+
+	node = headsecnode;
+	headsecnode = headsecnode->m_thinglist_next;
 	return node;
 }
 
@@ -4530,16 +4664,24 @@ static mprecipsecnode_t *P_GetPrecipSecnode(void)
 {
 	mprecipsecnode_t *node;
 
-	if (headprecipsecnode)
+	if (!headprecipsecnode)
 	{
-		node = headprecipsecnode;
-		headprecipsecnode = headprecipsecnode->m_thinglist_next;
+		mprecipsecnode_t *block = Z_Calloc(SECNODEBLOCK * sizeof (*block), PU_LEVEL, NULL);
+		size_t i;
+
+		for (i = 0; i < SECNODEBLOCK - 1; i++)
+			block[i].m_thinglist_next = &block[i+1];
+		block[SECNODEBLOCK - 1].m_thinglist_next = NULL;
+		headprecipsecnode = block;
 	}
-	else
-		node = Z_Calloc(sizeof (*node), PU_LEVEL, NULL);
+
+	node = headprecipsecnode;
+	headprecipsecnode = headprecipsecnode->m_thinglist_next;
 	return node;
 }
 
+#undef SECNODEBLOCK
+
 // P_PutSecnode() returns a node to the freelist.
 
 static inline void P_PutSecnode(msecnode_t *node)
@@ -4811,6 +4953,62 @@ static inline boolean PIT_GetPrecipSectors(line_t *ld)
 	return true;
 }
 
+// P_SecNodeListUnchanged checks whether the object's sector_list is already
+// exactly what P_CreateSecNodeList would build: a single node for the
+// sector of its subsector, with no (non-polyobject) line crossing its box.
+// This is the common case of something moving around in the open.
+
+static boolean P_SecNodeListUnchanged(mobj_t *thing, fixed_t x, fixed_t y)
+{
+	fixed_t bbox[4];
+	INT32 xl, xh, yl, yh, bx, by;
+
+	if (!sector_list || sector_list->m_sectorlist_next
+	|| sector_list->m_sector != thing->subsector->sector)
+		return false;
+
+	bbox[BOXTOP] = y + thing->radius;
+	bbox[BOXBOTTOM] = y - thing->radius;
+	bbox[BOXRIGHT] = x + thing->radius;
+	bbox[BOXLEFT] = x - thing->radius;
+
+	xl = (unsigned)(bbox[BOXLEFT] - bmaporgx)>>MAPBLOCKSHIFT;
+	xh = (unsigned)(bbox[BOXRIGHT] - bmaporgx)>>MAPBLOCKSHIFT;
+	yl = (unsigned)(bbox[BOXBOTTOM] - bmaporgy)>>MAPBLOCKSHIFT;
+	yh = (unsigned)(bbox[BOXTOP] - bmaporgy)>>MAPBLOCKSHIFT;
+
+	BMBOUNDFIX(xl, xh, yl, yh);
+
+	for (bx = xl; bx <= xh; bx++)
+		for (by = yl; by <= yh; by++)
+		{
+			const INT32 *list;
+
+			if (bx < 0 || by < 0 || bx >= bmapwidth || by >= bmapheight)
+				continue;
+
+			// Same tests as PIT_GetSectors
+			for (list = blockmaplump + blockmap[by*bmapwidth + bx] + 1; *list != -1; list++)
+			{
+				line_t *ld = &lines[*list];
+
+				if (ld->polyobj)
+					continue;
+
+				if (bbox[BOXRIGHT] <= ld->bbox[BOXLEFT]
+				|| bbox[BOXLEFT] >= ld->bbox[BOXRIGHT]
+				|| bbox[BOXTOP] <= ld->bbox[BOXBOTTOM]
+				|| bbox[BOXBOTTOM] >= ld->bbox[BOXTOP])
+					continue;
+
+				if (P_BoxOnLineSide(bbox, ld) == -1)
+					return false;
+			}
+		}
+
+	return true;
+}
+
 // P_CreateSecNodeList alters/creates the sector_list that shows what sectors
 // the object resides in.
 
@@ -4821,6 +5019,14 @@ void P_CreateSecNodeList(mobj_t *thing, fixed_t x, fixed_t y)
 	mobj_t *saved_tmthing = tmthing; /* cph - see comment at func end */
 	fixed_t saved_tmx = tmx, saved_tmy = tmy; /* ditto */
 
+	// Nothing to add or remove, so leave the list as it is.
+	if (P_SecNodeListUnchanged(thing, x, y))
+	{
+		sector_list->m_thing = thing;
+		tmflags = thing->flags; // the full path leaves this behind too
+		return;
+	}
+
 	// First, clear out the existing m_thing fields. As each node is
 	// added or verified as needed, m_thing will be set properly. When
 	// finished, delete all nodes where m_thing is still NULL. These
@@ -4977,6 +5183,139 @@ void P_MapEnd(void)
 	P_SetTarget(&tmthing, NULL);
 }
 
+//
+// FOF height cache
+//
+// P_FloorzAtPos and P_CeilingzAtPos only care about the solid FOFs of a
+// sector. Unsloped ones are kept in an array sorted by their midpoint
+// height, along with a running maximum of their tops and a running minimum
+// of their bottoms: the FOFs a query can stand on are then exactly a prefix
+// of the array, and the ones it can bump its head on exactly a suffix.
+// Sloped and quicksand FOFs depend on the position, so they are kept in a
+// short list and checked one by one as before.
+//
+// The cache is rebuilt lazily whenever P_InvalidateFOFHeights has been
+// called since it was made, which must happen whenever a plane or FOF flag
+// changes.
+//
+typedef struct
+{
+	fixed_t mid; // bottom + (top - bottom)/2, the sort key
+	fixed_t top, bottom;
+	fixed_t maxtop; // highest top among this and all lower entries
+	fixed_t minbottom; // lowest bottom among this and all higher entries
+} fofheight_t;
+
+typedef struct fofheights_s
+{
+	UINT32 epoch;
+	fofheight_t *flat;
+	size_t numflat;
+	ffloor_t **other; // sloped or quicksand FOFs
+	size_t numother;
+	size_t capacity;
+} fofheights_t;
+
+static UINT32 fofheightsepoch = 1;
+
+void P_InvalidateFOFHeights(void)
+{
+	if (++fofheightsepoch == 0)
+		fofheightsepoch = 1;
+}
+
+static boolean P_IsHeightFOF(ffloor_t *rover)
+{
+	if (!(rover->fofflags & FOF_EXISTS))
+		return false;
+	return !(!(rover->fofflags & FOF_SOLID || rover->fofflags & FOF_QUICKSAND) || (rover->fofflags & FOF_SWIMMABLE));
+}
+
+static fofheights_t *P_GetFOFHeights(sector_t *sec)
+{
+	fofheights_t *fh = sec->fofheights;
+	ffloor_t *rover;
+	size_t count = 0, i, j;
+
+	if (fh && fh->epoch == fofheightsepoch)
+		return fh;
+
+	if (!fh)
+		fh = sec->fofheights = Z_Calloc(sizeof (*fh), PU_LEVEL, NULL);
+
+	for (rover = sec->ffloors; rover; rover = rover->next)
+		count++;
+
+	if (count > fh->capacity)
+	{
+		fh->flat = Z_Realloc(fh->flat, count * sizeof (*fh->flat), PU_LEVEL, NULL);
+		fh->other = Z_Realloc(fh->other, count * sizeof (*fh->other), PU_LEVEL, NULL);
+		fh->capacity = count;
+	}
+
+	fh->numflat = fh->numother = 0;
+
+	for (rover = sec->ffloors; rover; rover = rover->next)
+	{
+		fofheight_t entry;
+
+		if (!P_IsHeightFOF(rover))
+			continue;
+
+		if ((rover->fofflags & FOF_QUICKSAND) || *rover->t_slope || *rover->b_slope)
+		{
+			fh->other[fh->numother++] = rover;
+			continue;
+		}
+
+		entry.top = *rover->topheight;
+		entry.bottom = *rover->bottomheight;
+		entry.mid = entry.bottom + ((entry.top - entry.bottom)/2);
+
+		// Insertion sort; sectors rarely have more than a handful of FOFs
+		for (j = fh->numflat; j > 0 && fh->flat[j-1].mid > entry.mid; j--)
+			fh->flat[j] = fh->flat[j-1];
+		fh->flat[j] = entry;
+		fh->numflat++;
+	}
+
+	for (i = 0; i < fh->numflat; i++)
+	{
+		fh->flat[i].maxtop = fh->flat[i].top;
+		if (i > 0 && fh->flat[i-1].maxtop > fh->flat[i].maxtop)
+			fh->flat[i].maxtop = fh->flat[i-1].maxtop;
+	}
+
+	for (i = fh->numflat; i-- > 0;)
+	{
+		fh->flat[i].minbottom = fh->flat[i].bottom;
+		if (i + 1 < fh->numflat && fh->flat[i+1].minbottom < fh->flat[i].minbottom)
+			fh->flat[i].minbottom = fh->flat[i+1].minbottom;
+	}
+
+	fh->epoch = fofheightsepoch;
+	return fh;
+}
+
+// Number of entries whose midpoint, doubled, is below (or at, if inclusive) key
+static size_t P_CountFOFsBelow(fofheights_t *fh, INT64 key, boolean inclusive)
+{
+	size_t lo = 0, hi = fh->numflat;
+
+	while (lo < hi)
+	{
+		size_t mid = (lo + hi)/2;
+		INT64 k = 2*(INT64)fh->flat[mid].mid;
+
+		if (k < key || (inclusive && k == key))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
 // P_FloorzAtPos
 // Returns the floorz of the XYZ position
 // Tails 05-26-2003
@@ -4988,17 +5327,32 @@ fixed_t P_FloorzAtPos(fixed_t x, fixed_t y, fixed_t z, fixed_t height)
 	// Intercept the stupid 'fall through 3dfloors' bug Tails 03-17-2002
 	if (sec->ffloors)
 	{
-		ffloor_t *rover;
+		fofheights_t *fh = P_GetFOFHeights(sec);
 		fixed_t delta1, delta2, thingtop = z + height;
+		size_t i;
 
-		for (rover = sec->ffloors; rover; rover = rover->next)
+		// abs(delta1) < abs(delta2) holds exactly when the midpoint is below z + height/2
+		if (height > 0)
 		{
-			fixed_t topheight, bottomheight;
-			if (!(rover->fofflags & FOF_EXISTS))
-				continue;
+			i = P_CountFOFsBelow(fh, 2*(INT64)z + height, false);
+			if (i > 0 && fh->flat[i-1].maxtop > floorz)
+				floorz = fh->flat[i-1].maxtop;
+		}
+		else if (height < 0)
+		{
+			for (i = 0; i < fh->numflat; i++)
+			{
+				delta1 = z - fh->flat[i].mid;
+				delta2 = thingtop - fh->flat[i].mid;
+				if (fh->flat[i].top > floorz && abs(delta1) < abs(delta2))
+					floorz = fh->flat[i].top;
+			}
+		}
 
-			if ((!(rover->fofflags & FOF_SOLID || rover->fofflags & FOF_QUICKSAND) || (rover->fofflags & FOF_SWIMMABLE)))
-				continue;
+		for (i = 0; i < fh->numother; i++)
+		{
+			ffloor_t *rover = fh->other[i];
+			fixed_t topheight, bottomheight;
 
 			topheight    = P_GetFFloorTopZAt   (rover, x, y);
 			bottomheight = P_GetFFloorBottomZAt(rover, x, y);
@@ -5032,17 +5386,32 @@ fixed_t P_CeilingzAtPos(fixed_t x, fixed_t y, fixed_t z, fixed_t height)
 
 	if (sec->ffloors)
 	{
-		ffloor_t *rover;
+		fofheights_t *fh = P_GetFOFHeights(sec);
 		fixed_t delta1, delta2, thingtop = z + height;
+		size_t i;
 
-		for (rover = sec->ffloors; rover; rover = rover->next)
+		// abs(delta1) > abs(delta2) holds exactly when the midpoint is above z + height/2
+		if (height > 0)
 		{
-			fixed_t topheight, bottomheight;
-			if (!(rover->fofflags & FOF_EXISTS))
-				continue;
+			i = P_CountFOFsBelow(fh, 2*(INT64)z + height, true);
+			if (i < fh->numflat && fh->flat[i].minbottom < ceilingz)
+				ceilingz = fh->flat[i].minbottom;
+		}
+		else if (height < 0)
+		{
+			for (i = 0; i < fh->numflat; i++)
+			{
+				delta1 = z - fh->flat[i].mid;
+				delta2 = thingtop - fh->flat[i].mid;
+				if (fh->flat[i].bottom < ceilingz && abs(delta1) > abs(delta2))
+					ceilingz = fh->flat[i].bottom;
+			}
+		}
 
-			if ((!(rover->fofflags & FOF_SOLID || rover->fofflags & FOF_QUICKSAND) || (rover->fofflags & FOF_SWIMMABLE)))
-				continue;
+		for (i = 0; i < fh->numother; i++)
+		{
+			ffloor_t *rover = fh->other[i];
+			fixed_t topheight, bottomheight;
 
 			topheight    = P_GetFFloorTopZAt   (rover, x, y);
 			bottomheight = P_GetFFloorBottomZAt(rover, x, y);
@@ -736,6 +736,110 @@ static void P_ReleaseBlockNode(blocknode_t *node)
 	freeblocks = node;
 }
 
+//
+// Thing cells
+//
+// With cv_blockmapcells on, every blockmap cell also keeps its things in a
+// flat array, so P_BlockThingsIterator can scan contiguous memory instead
+// of chasing blocknode pointers. The blocknode lists stay authoritative;
+// the arrays are built from them on first use and patched along with them
+// afterwards. Entries are kept oldest first, so walking an array backwards
+// visits things in exactly the same order as walking blocklinks.
+//
+
+consvar_t cv_blockmapcells = CVAR_INIT ("blockmapcells", "Off", CV_SAVE, CV_OnOff, NULL);
+
+typedef struct
+{
+	mobj_t *mobj;
+	blocknode_t *node;
+} thingcellentry_t;
+
+typedef struct
+{
+	thingcellentry_t *entries;
+	size_t count, capacity;
+	UINT32 changes; // bumped on every link and unlink
+} thingcell_t;
+
+static thingcell_t *thingcells = NULL; // NULL while not in use
+
+static void P_AddToThingCell(blocknode_t *node)
+{
+	thingcell_t *cell = &thingcells[node->blockindex];
+
+	if (cell->count == cell->capacity)
+	{
+		cell->capacity = cell->capacity ? cell->capacity * 2 : 4;
+		cell->entries = Z_Realloc(cell->entries, cell->capacity * sizeof (*cell->entries), PU_LEVEL, NULL);
+	}
+
+	cell->entries[cell->count].mobj = node->mobj;
+	cell->entries[cell->count].node = node;
+	cell->count++;
+	cell->changes++;
+}
+
+static void P_RemoveFromThingCell(blocknode_t *node)
+{
+	thingcell_t *cell = &thingcells[node->blockindex];
+	size_t i = cell->count;
+
+	// Recently linked things are the likeliest to move again
+	while (i-- > 0)
+	{
+		if (cell->entries[i].node == node)
+		{
+			memmove(&cell->entries[i], &cell->entries[i + 1], (cell->count - i - 1) * sizeof (*cell->entries));
+			cell->count--;
+			cell->changes++;
+			return;
+		}
+	}
+}
+
+static void P_BuildThingCells(void)
+{
+	size_t i, numcells = (size_t)bmapwidth * bmapheight;
+
+	thingcells = Z_Calloc(numcells * sizeof (*thingcells), PU_LEVEL, NULL);
+
+	for (i = 0; i < numcells; i++)
+	{
+		thingcell_t *cell = &thingcells[i];
+		blocknode_t *block;
+		size_t n = 0;
+
+		for (block = blocklinks[i]; block != NULL; block = block->mnext)
+			n++;
+
+		if (!n)
+			continue;
+
+		cell->capacity = cell->count = n;
+		cell->entries = Z_Malloc(n * sizeof (*cell->entries), PU_LEVEL, NULL);
+
+		// blocklinks is newest first; the array is oldest first
+		for (block = blocklinks[i]; block != NULL; block = block->mnext)
+		{
+			n--;
+			cell->entries[n].mobj = block->mobj;
+			cell->entries[n].node = block;
+		}
+	}
+}
+
+static void P_FreeThingCells(void)
+{
+	size_t i, numcells = (size_t)bmapwidth * bmapheight;
+
+	for (i = 0; i < numcells; i++)
+		Z_Free(thingcells[i].entries);
+
+	Z_Free(thingcells);
+	thingcells = NULL;
+}
+
 //
 // THING POSITION SETTING
 //
@@ -793,6 +897,8 @@ void P_UnsetThingPosition(mobj_t *thing)
 			if (block->mnext != NULL)
 				block->mnext->mprev = block->mprev;
 			*(block->mprev) = block->mnext;
+			if (thingcells)
+				P_RemoveFromThingCell(block);
 			blocknode_t *next = block->bnext;
 			P_ReleaseBlockNode(block);
 			block = next;
@@ -828,6 +934,8 @@ void P_SetThingPosition(mobj_t *thing)
 	I_Assert(thing != NULL);
 	I_Assert(!P_MobjWasRemoved(thing));
 
+	P_WakeMobj(thing); // moved by something else, perhaps
+
 	if (thing->player && thing->z <= thing->floorz && thing->subsector)
 		oldsec = thing->subsector->sector;
 
@@ -900,6 +1008,9 @@ void P_SetThingPosition(mobj_t *thing)
 					node->mprev = link;
 					*link = node;
 
+					if (thingcells)
+						P_AddToThingCell(node);
+
 					// Link in to actor
 					node->bprev = alink;
 					node->bnext = NULL;
@@ -1057,8 +1168,48 @@ boolean P_BlockThingsIterator(INT32 x, INT32 y, boolean (*func)(mobj_t *))
 	if (x < 0 || y < 0 || x >= bmapwidth || y >= bmapheight)
 		return true;
 
+	if (!cv_blockmapcells.value != !thingcells)
+	{
+		if (thingcells)
+			P_FreeThingCells();
+		else
+			P_BuildThingCells();
+	}
+
+	block = blocklinks[y*bmapwidth + x];
+
+	if (thingcells)
+	{
+		thingcell_t *cell = &thingcells[y*bmapwidth + x];
+		size_t i = cell->count;
+
+		while (i-- > 0)
+		{
+			UINT32 changes = cell->changes;
+
+			next = cell->entries[i].node->mnext;
+
+			if (!func(cell->entries[i].mobj))
+				return false;
+
+			if (P_MobjWasRemoved(tmthing)) // func just popped our tmthing, cannot continue.
+				return true;
+
+			// Things in this cell moved around, so the array index means
+			// nothing anymore. Carry on the way the list walk below would.
+			if (cell->changes != changes)
+			{
+				block = next;
+				break;
+			}
+		}
+
+		if (i == (size_t)-1)
+			return true;
+	}
+
 	// Check interaction with the objects in the blockmap.
-	for (block = blocklinks[y*bmapwidth + x]; block != NULL; block = next)
+	for (; block != NULL; block = next)
 	{
 		next = block->mnext; // We want to note our reference to mnext here!
 
@@ -1259,6 +1410,7 @@ void P_ClearBlockNodes(void)
 {
 	freeblocks = NULL;
 	freeiters = NULL;
+	thingcells = NULL; // freed along with the level
 }
 
 //
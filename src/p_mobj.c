@@ -515,6 +515,8 @@ boolean P_SetMobjState(mobj_t *mobj, statenum_t state)
 	if (mobj->player != NULL)
 		return P_SetPlayerMobjState(mobj, state);
 
+	P_WakeMobj(mobj);
+
 	if (recursion++) // if recursion detected,
 		memset(seenstate = tempstate, 0, sizeof tempstate); // clear state table
 
@@ -651,6 +653,8 @@ boolean P_SetMobjStateNF(mobj_t *mobj, statenum_t state)
 {
 	state_t *st;
 
+	P_WakeMobj(mobj);
+
 	if (state == S_NULL)
 	{ // Remove mobj
 		P_RemoveMobj(mobj);
@@ -3825,6 +3829,7 @@ void P_RecalcPrecipInSector(sector_t *sector)
 		return;
 
 	sector->moved = true; // Recalc lighting and things too, maybe
+	P_InvalidateFOFHeights();
 
 	for (psecnode = sector->touching_preciplist; psecnode; psecnode = psecnode->m_thinglist_next)
 		CalculatePrecipFloor(psecnode->m_thing);
@@ -4579,6 +4584,9 @@ static void P_Boss4DestroyCage(mobj_t *mobj)
 						rover->fofflags &= ~FOF_EXISTS;
 						sector->moved = true;
 						rsec->moved = true;
+						P_InvalidateSightCache();
+						P_InvalidateFOFHeights();
+						P_WakeAllMobjs();
 					}
 				}
 		}
@@ -10134,6 +10142,109 @@ static boolean P_FuseThink(mobj_t *mobj)
 	return !P_MobjWasRemoved(mobj);
 }
 
+//
+// Mobj sleeping
+//
+// Most mobjs on a big map are idle: rings, scenery and enemies standing in
+// a state that never ends, far away from anyone. With sleepmobjs on, such a
+// mobj gets MFE_SLEEPING, and P_MobjThinker then only advances its sprite
+// animation until a player comes within sleepradius or something wakes it
+// with P_WakeMobj (state changes, damage, being moved or thrust, sector
+// movement, level geometry changes, Lua writes).
+//
+// The decision only depends on synced game state, and the flag is saved
+// along with the rest of eflags, so every client sleeps the same mobjs.
+//
+
+static CV_PossibleValue_t sleepradius_cons_t[] = {{512, "MIN"}, {16384, "MAX"}, {0, NULL}};
+consvar_t cv_sleepmobjs = CVAR_INIT ("sleepmobjs", "Off", CV_SAVE|CV_NETVAR, CV_OnOff, NULL);
+consvar_t cv_sleepradius = CVAR_INIT ("sleepradius", "2048", CV_SAVE|CV_NETVAR, sleepradius_cons_t, NULL);
+
+static boolean P_PlayerNearMobj(mobj_t *mobj)
+{
+	INT32 i;
+
+	for (i = 0; i < MAXPLAYERS; i++)
+	{
+		mobj_t *mo;
+		fixed_t radius;
+
+		if (!playeringame[i])
+			continue;
+
+		mo = players[i].mo;
+		if (P_MobjWasRemoved(mo))
+			continue;
+
+		// Bigger players reach further (ring attraction, for one)
+		radius = FixedMul(cv_sleepradius.value << FRACBITS, max(mo->scale, FRACUNIT)) + mobj->radius;
+
+		if (P_AproxDistance(mo->x - mobj->x, mo->y - mobj->y) < radius)
+			return true;
+	}
+
+	return false;
+}
+
+static boolean P_MobjCanSleep(mobj_t *mobj)
+{
+	if (mobj->player || mobj->health <= 0)
+		return false;
+
+	if (mobj->flags & (MF_BOSS|MF_PUSHABLE|MF_AMBIENT|MF_MISSILE|MF_NOCLIPTHING))
+		return false;
+
+	if (mobj->flags2 & (MF2_SKULLFLY|MF2_FIRING|MF2_NIGHTSPULL))
+		return false;
+
+	if (mobj->eflags & (MFE_TRACERANGLE|MFE_JUSTHITFLOOR|MFE_APPLYPMOMZ))
+		return false;
+
+	// Nothing left to do: no movement, no state timer, no fuse, no scaling
+	if (mobj->momx || mobj->momy || mobj->momz || mobj->pmomz
+		|| mobj->tics != -1 || mobj->fuse || mobj->scale != mobj->destscale)
+		return false;
+
+	// Followers and chains are driven by what they're attached to
+	if (mobj->target || mobj->tracer || mobj->hnext || mobj->hprev)
+		return false;
+
+	// Must be resting on the floor (or ceiling), unless gravity doesn't apply
+	if (!(mobj->flags & MF_NOGRAVITY))
+	{
+		if (!(mobj->eflags & MFE_ONGROUND))
+			return false;
+		if ((mobj->eflags & MFE_VERTICALFLIP) ? mobj->z + mobj->height != mobj->ceilingz : mobj->z != mobj->floorz)
+			return false;
+	}
+
+	if (!mobj->subsector || (mobj->subsector->sector->flags & MSF_TRIGGERLINE_MOBJ))
+		return false;
+
+	if (LUA_MobjHookAvailable(mobj->type, MOBJ_HOOK(MobjThinker))
+		|| LUA_MobjHookAvailable(mobj->type, MOBJ_HOOK(MobjThinkerBatch))
+		|| LUA_MobjHookAvailable(mobj->type, MOBJ_HOOK(MobjMoveCollide)))
+		return false;
+
+	return !P_PlayerNearMobj(mobj);
+}
+
+/** Wakes every sleeping mobj, for changes that can affect mobjs anywhere.
+  */
+void P_WakeAllMobjs(void)
+{
+	thinker_t *th;
+
+	// With sleeping off, any mobj still flagged wakes on its own next turn.
+	// Before the first level, there is no thinker list to walk yet.
+	if (!cv_sleepmobjs.value || !thlist[THINK_MOBJ].next)
+		return;
+
+	for (th = thlist[THINK_MOBJ].next; th != &thlist[THINK_MOBJ]; th = th->next)
+		if (th->function == (actionf_p1)P_MobjThinker)
+			P_WakeMobj((mobj_t *)th);
+}
+
 //
 // P_MobjThinker
 //
@@ -10148,6 +10259,22 @@ void P_MobjThinker(mobj_t *mobj)
 	if ((mobj->flags & MF_BOSS) && mobj->spawnpoint && (bossdisabled & (1<<mobj->spawnpoint->args[0])))
 		return;
 
+	if (mobj->eflags & MFE_SLEEPING)
+	{
+		if (cv_sleepmobjs.value && !P_PlayerNearMobj(mobj))
+		{
+			P_CycleStateAnimation(mobj);
+			return;
+		}
+		P_WakeMobj(mobj);
+	}
+	else if (cv_sleepmobjs.value && P_MobjCanSleep(mobj))
+	{
+		mobj->eflags |= MFE_SLEEPING;
+		P_CycleStateAnimation(mobj);
+		return;
+	}
+
 	// Remove dead target/tracer.
 	if (mobj->target && P_MobjWasRemoved(mobj->target))
 		P_SetTarget(&mobj->target, NULL);
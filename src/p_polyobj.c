@@ -916,6 +916,87 @@ static void Polyobj_carryThings(polyobj_t *po, fixed_t dx, fixed_t dy)
 	}
 }
 
+// Things near a moving polyobject, gathered once per move so lines that
+// nothing is touching can skip the blockmap walk in Polyobj_clipThings.
+static mobj_t **po_candidates = NULL;
+static size_t po_numcandidates = 0;
+static size_t po_maxcandidates = 0;
+
+// Gathers every thing in the blockmap cells under the polyobject's lines
+// whose box overlaps the polyobject's bounding box at its new position.
+static void Polyobj_gatherCandidates(polyobj_t *po)
+{
+	fixed_t box[4];
+	INT32 xl, xh, yl, yh, x, y;
+	size_t i;
+
+	po_numcandidates = 0;
+
+	if (!(po->flags & POF_SOLID))
+		return;
+
+	box[BOXLEFT]   = box[BOXRIGHT] = po->vertices[0]->x;
+	box[BOXBOTTOM] = box[BOXTOP]   = po->vertices[0]->y;
+
+	for (i = 1; i < po->numVertices; ++i)
+		M_AddToBox(box, po->vertices[i]->x, po->vertices[i]->y);
+
+	xl = max((box[BOXLEFT]   - bmaporgx) >> MAPBLOCKSHIFT, 0);
+	xh = min((box[BOXRIGHT]  - bmaporgx) >> MAPBLOCKSHIFT, bmapwidth - 1);
+	yl = max((box[BOXBOTTOM] - bmaporgy) >> MAPBLOCKSHIFT, 0);
+	yh = min((box[BOXTOP]    - bmaporgy) >> MAPBLOCKSHIFT, bmapheight - 1);
+
+	for (y = yl; y <= yh; ++y)
+	{
+		for (x = xl; x <= xh; ++x)
+		{
+			blocknode_t *block;
+
+			for (block = blocklinks[y * bmapwidth + x]; block != NULL; block = block->mnext)
+			{
+				mobj_t *mo = block->mobj;
+
+				if (mo->flags & (MF_NOGRAVITY|MF_NOCLIP))
+					continue;
+
+				if (mo->x + mo->radius <= box[BOXLEFT] || mo->x - mo->radius >= box[BOXRIGHT]
+				|| mo->y + mo->radius <= box[BOXBOTTOM] || mo->y - mo->radius >= box[BOXTOP])
+					continue;
+
+				if (po_numcandidates >= po_maxcandidates)
+				{
+					po_maxcandidates = po_maxcandidates ? po_maxcandidates * 2 : 64;
+					po_candidates = Z_Realloc(po_candidates, po_maxcandidates * sizeof (*po_candidates), PU_STATIC, NULL);
+				}
+				po_candidates[po_numcandidates++] = mo;
+			}
+		}
+	}
+}
+
+// Checks whether any gathered thing would be hit by a line, with the same
+// tests Polyobj_clipThings applies. Only valid until something is hit.
+static boolean Polyobj_lineHasCandidates(line_t *line)
+{
+	size_t i;
+
+	for (i = 0; i < po_numcandidates; ++i)
+	{
+		mobj_t *mo = po_candidates[i];
+
+		if (mo->z + mo->height <= line->backsector->floorheight)
+			continue;
+
+		if (mo->z >= line->backsector->ceilingheight)
+			continue;
+
+		if (!Polyobj_untouched(line, mo))
+			return true;
+	}
+
+	return false;
+}
+
 // Checks for things that are in the way of a polyobject line move.
 // Returns true if something was hit.
 static INT32 Polyobj_clipThings(polyobj_t *po, line_t *line)
@@ -998,6 +1079,8 @@ boolean Polyobj_moveXY(polyobj_t *po, fixed_t x, fixed_t y, boolean checkmobjs)
 	if (po->isBad)
 		return false;
 
+	P_InvalidateSightCache();
+
 	// translate vertices
 	for (i = 0; i < po->numVertices; ++i)
 		Polyobj_vecAdd(po->vertices[i], &vec);
@@ -1008,9 +1091,16 @@ boolean Polyobj_moveXY(polyobj_t *po, fixed_t x, fixed_t y, boolean checkmobjs)
 
 	if (checkmobjs)
 	{
+		Polyobj_gatherCandidates(po);
+
 		// check for blocking things (yes, it needs to be done separately)
 		for (i = 0; i < po->numLines; ++i)
+		{
+			// Nothing moves until something is hit, so until then the gathered things are all there is
+			if (!hitflags && !Polyobj_lineHasCandidates(po->lines[i]))
+				continue;
 			hitflags |= Polyobj_clipThings(po, po->lines[i]);
+		}
 	}
 
 	if (hitflags & 2)
@@ -1187,6 +1277,8 @@ boolean Polyobj_rotate(polyobj_t *po, angle_t delta, boolean turnplayers, boolea
 	if (po->isBad)
 		return false;
 
+	P_InvalidateSightCache();
+
 	angle = (po->angle + delta) >> ANGLETOFINESHIFT;
 
 	// point about which to rotate is the spawn spot
@@ -1210,9 +1302,16 @@ boolean Polyobj_rotate(polyobj_t *po, angle_t delta, boolean turnplayers, boolea
 
 	if (checkmobjs)
 	{
+		Polyobj_gatherCandidates(po);
+
 		// check for blocking things
 		for (i = 0; i < po->numLines; ++i)
+		{
+			// Nothing moves until something is hit, so until then the gathered things are all there is
+			if (!hitflags && !Polyobj_lineHasCandidates(po->lines[i]))
+				continue;
 			hitflags |= Polyobj_clipThings(po, po->lines[i]);
+		}
 
 		Polyobj_rotateThings(po, origin, delta, turnplayers, turnothers);
 	}
@@ -1968,6 +1968,8 @@ static void P_NetUnArchiveWorld(save_t *save_p)
 
 	UnArchiveSectors(save_p);
 	UnArchiveLines(save_p);
+
+	P_InvalidateFOFHeights(); // planes and FOF flags were just restored
 }
 
 //
@@ -147,6 +147,11 @@ blocknode_t **blocklinks;
 //
 UINT8 *rejectmatrix;
 
+// Generated in place of a missing REJECT lump: the sight group of every
+// sector, or -1 for sectors that are never rejected. Two sectors with
+// different groups can't see each other.
+INT32 *rejectgroups;
+
 // Maintain single and multi player starting spots.
 INT32 numdmstarts, numcoopstarts, numredctfstarts, numbluectfstarts;
 
@@ -4135,6 +4140,8 @@ static void P_CreateBlockMap(void)
 // -- Monster Iestyn 09/01/18
 static void P_LoadReject(UINT8 *data, size_t count)
 {
+	rejectgroups = NULL;
+
 	if (!count) // zero length, someone probably used ZDBSP
 	{
 		rejectmatrix = NULL;
@@ -4147,16 +4154,177 @@ static void P_LoadReject(UINT8 *data, size_t count)
 	}
 }
 
+static size_t P_FindRejectGroup(size_t *groups, size_t i)
+{
+	while (groups[i] != i)
+		i = groups[i] = groups[groups[i]];
+	return i;
+}
+
+static void P_JoinRejectGroups(size_t *groups, const sector_t *a, const sector_t *b)
+{
+	size_t ga, gb;
+
+	if (!a || !b || a == b)
+		return;
+
+	ga = P_FindRejectGroup(groups, (size_t)(a - sectors));
+	gb = P_FindRejectGroup(groups, (size_t)(b - sectors));
+
+	if (ga < gb)
+		groups[gb] = ga;
+	else if (gb < ga)
+		groups[ga] = gb;
+}
+
+static int P_CompareRejectEdges(const void *a, const void *b)
+{
+	const size_t *ea = a, *eb = b;
+
+	if (ea[0] != eb[0])
+		return ea[0] < eb[0] ? -1 : 1;
+	if (ea[1] != eb[1])
+		return ea[1] < eb[1] ? -1 : 1;
+	return 0;
+}
+
+//
+// P_CreateReject
+//
+// Builds a REJECT table for maps that lack one.
+//
+// Sector heights can be changed at any time by linedef executors and Lua,
+// so no height-based visibility can be assumed here. Instead, sectors are
+// grouped by whatever could ever let a sight line pass between them:
+// linedefs with a back side, and segs sharing a subsector. Only sectors in
+// different groups are rejected, which never changes the outcome of
+// P_CheckSight and still catches areas joined only by teleporters,
+// FOF control sectors and the like.
+//
+// Sectors that are not closed (some vertex touches an odd number of their
+// boundary lines) could leak sight through the gap, so they are never
+// rejected against anything.
+//
+// Rather than a numsectors * numsectors bit matrix, the result is one
+// group number per sector (rejectgroups), which P_CheckSight compares.
+//
+static void P_CreateReject(void)
+{
+	size_t *groups, *edges;
+	boolean *leaky;
+	size_t numedges = 0;
+	size_t i, j, start;
+	size_t numgroups = 0;
+
+	rejectmatrix = NULL;
+	rejectgroups = NULL;
+
+	if (numsectors < 2)
+		return;
+
+	groups = Z_Malloc(numsectors * sizeof (*groups), PU_STATIC, NULL);
+	leaky = Z_Calloc(numsectors * sizeof (*leaky), PU_STATIC, NULL);
+	edges = Z_Malloc(numlines * 8 * sizeof (*edges), PU_STATIC, NULL); // up to two (sector, vertex) pairs per side
+
+	for (i = 0; i < numsectors; i++)
+		groups[i] = i;
+
+	for (i = 0; i < numlines; i++)
+	{
+		line_t *ld = &lines[i];
+
+		P_JoinRejectGroups(groups, ld->frontsector, ld->backsector);
+
+		// A line with the same sector on both sides is not part of its boundary.
+		if (ld->frontsector == ld->backsector)
+			continue;
+
+		if (ld->frontsector)
+		{
+			edges[numedges++] = (size_t)(ld->frontsector - sectors);
+			edges[numedges++] = (size_t)(ld->v1 - vertexes);
+			edges[numedges++] = (size_t)(ld->frontsector - sectors);
+			edges[numedges++] = (size_t)(ld->v2 - vertexes);
+		}
+
+		if (ld->backsector)
+		{
+			edges[numedges++] = (size_t)(ld->backsector - sectors);
+			edges[numedges++] = (size_t)(ld->v1 - vertexes);
+			edges[numedges++] = (size_t)(ld->backsector - sectors);
+			edges[numedges++] = (size_t)(ld->v2 - vertexes);
+		}
+	}
+
+	for (i = 0; i < numsubsectors; i++)
+	{
+		const subsector_t *ss = &subsectors[i];
+		const sector_t *first = NULL;
+
+		for (j = 0; j < (size_t)ss->numlines; j++)
+		{
+			const seg_t *seg;
+
+			if (ss->firstline + j >= numsegs)
+				break;
+
+			seg = &segs[ss->firstline + j];
+
+			if (!first)
+				first = seg->frontsector;
+			P_JoinRejectGroups(groups, first, seg->frontsector);
+			P_JoinRejectGroups(groups, seg->frontsector, seg->backsector);
+		}
+	}
+
+	// Each edge takes two slots (sector, vertex);
+	// find the pairs that occur an odd number of times.
+	numedges /= 2;
+	qsort(edges, numedges, 2 * sizeof (*edges), P_CompareRejectEdges);
+	for (start = 0; start < numedges; start = i)
+	{
+		for (i = start + 1; i < numedges; i++)
+			if (P_CompareRejectEdges(&edges[2*start], &edges[2*i]))
+				break;
+		if ((i - start) & 1)
+			leaky[edges[2*start]] = true;
+	}
+
+	for (i = 0; i < numsectors; i++)
+	{
+		groups[i] = P_FindRejectGroup(groups, i);
+		if (groups[i] == i)
+			numgroups++;
+	}
+
+	if (numgroups > 1)
+	{
+		rejectgroups = Z_Malloc(numsectors * sizeof (*rejectgroups), PU_LEVEL, NULL);
+
+		for (i = 0; i < numsectors; i++)
+			rejectgroups[i] = leaky[i] ? -1 : (INT32)groups[i];
+	}
+
+	CONS_Debug(DBG_SETUP, "P_CreateReject: %s sector groups%s\n", sizeu1(numgroups),
+		rejectgroups ? "" : ", not needed");
+
+	Z_Free(edges);
+	Z_Free(leaky);
+	Z_Free(groups);
+}
+
 static void P_LoadMapLUT(const virtres_t *virt)
 {
 	virtlump_t* virtblockmap = vres_Find(virt, "BLOCKMAP");
 	virtlump_t* virtreject   = vres_Find(virt, "REJECT");
 
 	// Lookup tables
-	if (virtreject)
+	// A REJECT lump that is missing, empty or too short for this map
+	// (nodebuilders that skip it, most UDMF maps) gets generated instead.
+	if (virtreject && virtreject->size >= (numsectors * numsectors + 7) / 8)
 		P_LoadReject(virtreject->data, virtreject->size);
 	else
-		rejectmatrix = NULL;
+		P_CreateReject();
 
 	if (!(virtblockmap && P_LoadBlockMap(virtblockmap->data, virtblockmap->size)))
 		P_CreateBlockMap();
@@ -8001,6 +8169,7 @@ boolean P_LoadLevel(boolean fromnetsave, boolean reloadinggamestate)
 
 	// Clear pointers that would be left dangling by the purge
 	R_FlushTranslationColormapCache();
+	LUA_HUD_FlushDrawLists();
 
 #ifdef HWRENDER
 	// Free GPU textures before freeing patches.
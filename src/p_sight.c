@@ -17,6 +17,7 @@
 #include "p_slopes.h"
 #include "r_main.h"
 #include "r_state.h"
+#include "m_perfstats.h"
 
 //
 // P_CheckSight
@@ -33,6 +34,71 @@ typedef struct {
 
 static INT32 sightcounts[2];
 
+//
+// Line-of-sight cache
+//
+// Mobj thinkers tend to ask the same sight questions several times per tic
+// (A_Look, A_Chase, homing, targeting), so the answers are remembered for as
+// long as the level geometry is known not to have changed. The key is purely
+// the positions and heights of both mobjs: the result of the full check below
+// only depends on those and the level geometry, so a cache hit always gives
+// the same answer the uncached path would have, and every client agrees.
+//
+// The cache is only consulted while P_SetSightCacheActive has switched it on
+// (the mobj thinker pass), so sight checks made from the renderer or HUD code
+// can neither read nor leave behind anything. P_InvalidateSightCache must be
+// called whenever sector, FOF or polyobject geometry changes.
+//
+
+#define SIGHTCACHESIZE 512 // must be a power of two
+
+typedef struct
+{
+	UINT32 epoch; // valid only while this equals sightcacheepoch
+	fixed_t x1, y1, z1, height1;
+	fixed_t x2, y2, z2, height2;
+	boolean result;
+} sightcache_t;
+
+static sightcache_t sightcache[SIGHTCACHESIZE];
+static UINT32 sightcacheepoch = 1;
+static boolean sightcacheactive = false;
+
+/** Forgets every cached line-of-sight result.
+  * Must be called after any change to the level geometry.
+  */
+void P_InvalidateSightCache(void)
+{
+	if (++sightcacheepoch == 0)
+	{
+		// Wrapped around; make sure no stale entry can match again.
+		memset(sightcache, 0, sizeof(sightcache));
+		sightcacheepoch = 1;
+	}
+}
+
+/** Turns the line-of-sight cache on or off.
+  * Either way, the cache starts out empty.
+  *
+  * \param active True to cache results, false to always do full checks.
+  */
+void P_SetSightCacheActive(boolean active)
+{
+	sightcacheactive = active;
+	P_InvalidateSightCache();
+}
+
+static inline sightcache_t *P_GetSightCacheEntry(const mobj_t *t1, const mobj_t *t2)
+{
+	UINT32 hash = (UINT32)(t1->x ^ (t1->y * 3) ^ (t1->z * 5));
+
+	hash = hash * 31 + (UINT32)(t2->x ^ (t2->y * 3) ^ (t2->z * 5));
+	hash ^= hash >> 16;
+	hash ^= hash >> 9;
+
+	return &sightcache[hash & (SIGHTCACHESIZE - 1)];
+}
+
 //
 // P_DivlineSide
 //
@@ -377,11 +443,12 @@ static boolean P_CrossBSPNode(INT32 bspnum, register los_t *los)
 // Returns true if a straight line between t1 and t2 is unobstructed.
 // Uses REJECT.
 //
+static boolean P_CheckSightLOS(mobj_t *t1, mobj_t *t2, const sector_t *s1, const sector_t *s2);
+
 boolean P_CheckSight(mobj_t *t1, mobj_t *t2)
 {
 	const sector_t *s1, *s2;
 	size_t pnum;
-	los_t los;
 
 	// First check for trivial rejection.
 	if (!t1 || !t2)
@@ -404,6 +471,13 @@ boolean P_CheckSight(mobj_t *t1, mobj_t *t2)
 		if (rejectmatrix[pnum>>3] & (1 << (pnum&7))) // can't possibly be connected
 			return false;
 	}
+	else if (rejectgroups != NULL)
+	{
+		// Same, with the table P_CreateReject made
+		const INT32 g1 = rejectgroups[s1-sectors], g2 = rejectgroups[s2-sectors];
+		if (g1 != -1 && g2 != -1 && g1 != g2)
+			return false;
+	}
 
 	// killough 11/98: shortcut for melee situations
 	// same subsector? obviously visible
@@ -412,6 +486,46 @@ boolean P_CheckSight(mobj_t *t1, mobj_t *t2)
 		t1->subsector == t2->subsector)
 		return true;
 
+	if (sightcacheactive)
+	{
+		sightcache_t *entry = P_GetSightCacheEntry(t1, t2);
+
+		if (entry->epoch == sightcacheepoch
+			&& entry->x1 == t1->x && entry->y1 == t1->y && entry->z1 == t1->z && entry->height1 == t1->height
+			&& entry->x2 == t2->x && entry->y2 == t2->y && entry->z2 == t2->z && entry->height2 == t2->height)
+		{
+			ps_sightcache_hits.value.i++;
+			return entry->result;
+		}
+
+		ps_sightcache_misses.value.i++;
+
+		entry->epoch = sightcacheepoch;
+		entry->x1 = t1->x;
+		entry->y1 = t1->y;
+		entry->z1 = t1->z;
+		entry->height1 = t1->height;
+		entry->x2 = t2->x;
+		entry->y2 = t2->y;
+		entry->z2 = t2->z;
+		entry->height2 = t2->height;
+		entry->result = P_CheckSightLOS(t1, t2, s1, s2);
+		return entry->result;
+	}
+
+	return P_CheckSightLOS(t1, t2, s1, s2);
+}
+
+//
+// P_CheckSightLOS
+//
+// The expensive part of P_CheckSight, once REJECT and
+// the trivial cases could not decide the answer.
+//
+static boolean P_CheckSightLOS(mobj_t *t1, mobj_t *t2, const sector_t *s1, const sector_t *s2)
+{
+	los_t los;
+
 	// An unobstructed LOS is possible.
 	// Now look from eyes of t1 to any part of t2.
 	sightcounts[1]++;
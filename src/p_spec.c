@@ -1251,6 +1251,9 @@ void T_ExecutorDelay(executor_t *e)
 		if (e->caller && P_MobjWasRemoved(e->caller)) // If the mobj died while we were delaying
 			P_SetTarget(&e->caller, NULL); // Call with no mobj!
 		P_ProcessLineSpecial(e->line, e->caller, e->sector);
+		P_InvalidateSightCache(); // the executor may have changed the level geometry
+		P_InvalidateFOFHeights();
+		P_WakeAllMobjs();
 		P_SetTarget(&e->caller, NULL); // Let the mobj know it can be removed now.
 		P_RemoveThinker(&e->thinker);
 	}
@@ -1573,7 +1576,12 @@ static void P_ActivateLinedefExecutor(line_t *line, mobj_t *actor, sector_t *cal
 	if (line->executordelay)
 		P_AddExecutorDelay(line, actor, caller);
 	else
+	{
 		P_ProcessLineSpecial(line, actor, caller);
+		P_InvalidateSightCache(); // the executor may have changed the level geometry
+		P_InvalidateFOFHeights();
+		P_WakeAllMobjs();
+	}
 }
 
 static boolean P_ActivateLinedefExecutorsInSector(line_t *triggerline, mobj_t *actor, sector_t *caller)
@@ -7506,6 +7514,46 @@ static void P_DoScrollMove(mobj_t *thing, fixed_t dx, fixed_t dy, INT32 exclusiv
 		thing->eflags |= MFE_PUSHED;
 }
 
+/** Gets the height a scroller follows the changes of.
+  *
+  * \param s Thinker structure for this scroller.
+  * \return The summed floor and ceiling height of the control sector, or 0 if there is none.
+  */
+fixed_t P_ScrollControlHeight(scroll_t *s)
+{
+	if (s->control == -1)
+		return 0;
+	return sectors[s->control].floorheight + sectors[s->control].ceilingheight;
+}
+
+/** Works out how far a scroller moves this tic.
+  * Only touches the scroller itself, so it may run ahead of time in parallel.
+  *
+  * \param s  Thinker structure for this scroller.
+  * \param dx Set to the x scroll amount.
+  * \param dy Set to the y scroll amount.
+  */
+void P_StepScroll(scroll_t *s, fixed_t *dx, fixed_t *dy)
+{
+	*dx = s->dx;
+	*dy = s->dy;
+
+	if (s->control != -1)
+	{ // compute scroll amounts based on a sector's height changes
+		fixed_t height = P_ScrollControlHeight(s);
+		fixed_t delta = height - s->last_height;
+		s->last_height = height;
+		*dx = FixedMul(*dx, delta);
+		*dy = FixedMul(*dy, delta);
+	}
+
+	if (s->accel)
+	{
+		s->vdx = *dx += s->vdx;
+		s->vdy = *dy += s->vdy;
+	}
+}
+
 /** Processes an active scroller.
   * This function, with the help of r_plane.c and r_bsp.c, supports generalized
   * scrolling floors and walls, with optional mobj-carrying properties, e.g.
@@ -7530,24 +7578,17 @@ static void P_DoScrollMove(mobj_t *thing, fixed_t dx, fixed_t dy, INT32 exclusiv
   */
 void T_Scroll(scroll_t *s)
 {
-	fixed_t dx = s->dx, dy = s->dy;
+	thinkerresult_t *res = P_GetThinkerResult(&s->thinker, P_ScrollControlHeight(s));
+	fixed_t dx, dy;
 	boolean is3dblock = false;
 
-	if (s->control != -1)
-	{ // compute scroll amounts based on a sector's height changes
-		fixed_t height = sectors[s->control].floorheight +
-			sectors[s->control].ceilingheight;
-		fixed_t delta = height - s->last_height;
-		s->last_height = height;
-		dx = FixedMul(dx, delta);
-		dy = FixedMul(dy, delta);
-	}
-
-	if (s->accel)
+	if (res)
 	{
-		s->vdx = dx += s->vdx;
-		s->vdy = dy += s->vdy;
+		dx = res->out[0];
+		dy = res->out[1];
 	}
+	else
+		P_StepScroll(s, &dx, &dy);
 
 //	if (!(dx | dy)) // no-op if both (x,y) offsets 0
 //		return;
@@ -8259,6 +8300,8 @@ static boolean P_FadeFakeFloor(ffloor_t *rover, INT16 sourcevalue, INT16 destval
 	if (fadingdata)
 		fadingdata->alpha = alpha;
 
+	P_InvalidateFOFHeights(); // collision flags may have changed
+
 	return stillfading;
 }
 
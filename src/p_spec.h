@@ -658,11 +658,13 @@ void P_SpawnLightningFlash(sector_t *sector);
 strobe_t * P_SpawnAdjustableStrobeFlash(sector_t *sector, INT16 lighta, INT16 lightb, INT32 darktime, INT32 brighttime, boolean inSync);
 
 void T_Glow(glow_t *g);
+INT16 P_StepGlow(glow_t *g, INT16 lightlevel);
 glow_t *P_SpawnAdjustableGlowingLight(sector_t *sector, INT16 lighta, INT16 lightb, INT32 length);
 
 void P_FadeLightBySector(sector_t *sector, INT32 destvalue, INT32 speed, boolean ticbased);
 void P_FadeLight(INT16 tag, INT32 destvalue, INT32 speed, boolean ticbased, boolean force, boolean relative);
 void T_LightFade(lightlevel_t *ll);
+boolean P_StepLightFade(lightlevel_t *ll, INT16 *level);
 
 typedef enum
 {
@@ -994,6 +996,8 @@ typedef struct
 } scroll_t;
 
 void T_Scroll(scroll_t *s);
+fixed_t P_ScrollControlHeight(scroll_t *s);
+void P_StepScroll(scroll_t *s, fixed_t *dx, fixed_t *dy);
 void T_LaserFlash(laserthink_t *flash);
 
 /** Friction for ice/sludge effects.
@@ -23,6 +23,7 @@
 #include "lua_hook.h"
 #include "m_perfstats.h"
 #include "i_system.h" // I_GetPreciseTime
+#include "i_threads.h"
 #include "r_main.h"
 #include "r_fps.h"
 #include "i_video.h" // rendermode
@@ -49,6 +50,15 @@ tic_t leveltime;
 // The entries will behave like both the head and tail of the lists.
 thinker_t thlist[NUM_THINKERLISTS];
 
+// Run thinkers grouped by what they are instead of in list order.
+// Netvar, since it changes the order things happen in.
+consvar_t cv_sortthinkers = CVAR_INIT ("sortthinkers", "Off", CV_SAVE|CV_NETVAR, CV_OnOff, NULL);
+
+// Worker threads for stepping sector thinkers ahead of time.
+// Local, since the results are the same as running them in order.
+static CV_PossibleValue_t thinkerthreads_cons_t[] = {{0, "MIN"}, {16, "MAX"}, {0, NULL}};
+consvar_t cv_thinkerthreads = CVAR_INIT ("thinkerthreads", "0", CV_SAVE, thinkerthreads_cons_t, NULL);
+
 void Command_Numthinkers_f(void)
 {
 	INT32 num;
@@ -194,6 +204,149 @@ void Command_CountMobjs_f(void)
 	}
 }
 
+//
+// Type-sorted thinker dispatch (cv_sortthinkers)
+//
+// Each tic, a thinker list is copied into an array grouped by thinker
+// function, and for mobjs by mobj type, so that runs of the same code
+// operate on the same kind of data. Groups are ordered by the first time
+// they appear in the list, and thinkers keep their list order within a
+// group, so the order only depends on the (synced) list itself and is the
+// same on every client regardless of where functions ended up in memory.
+//
+// Thinkers added while the list runs go to a pending array and run at the
+// end, just like they would at the end of the linked list.
+//
+
+#define THINKERGROUPHASHSIZE 4096 // must be a power of two
+
+typedef struct
+{
+	think_t function;
+	INT32 type; // mobj type, or -1 for anything else
+	UINT32 stamp; // entry only valid while this equals groupstamp
+	UINT32 group;
+} thinkergroup_t;
+
+static thinkergroup_t thinkergroups[THINKERGROUPHASHSIZE];
+static UINT32 groupstamp = 0;
+static UINT32 *groupstarts = NULL;
+static size_t groupstarts_max = 0;
+
+static thinker_t **listorder = NULL; // thinkers in list order
+static UINT32 *listgroups = NULL; // group of each entry in listorder
+static thinker_t **sortedorder = NULL; // the same thinkers, grouped
+static size_t sortedorder_max = 0;
+
+static thinker_t **pendingthinkers = NULL;
+static size_t numpendingthinkers = 0;
+static size_t pendingthinkers_max = 0;
+
+// The list currently running sorted, if any
+static thinklistnum_t sortedlist = NUM_THINKERLISTS;
+
+static void P_AddSortedThinker(thinker_t *thinker)
+{
+	if (numpendingthinkers >= pendingthinkers_max)
+	{
+		pendingthinkers_max = pendingthinkers_max ? pendingthinkers_max * 2 : 64;
+		pendingthinkers = Z_Realloc(pendingthinkers, pendingthinkers_max * sizeof (*pendingthinkers), PU_STATIC, NULL);
+	}
+	pendingthinkers[numpendingthinkers++] = thinker;
+}
+
+// Returns the group a thinker belongs to, or UINT32_MAX if the table is full.
+static UINT32 P_GetThinkerGroup(thinker_t *thinker, UINT32 *numgroups)
+{
+	think_t function = thinker->function;
+	INT32 type = -1;
+	UINT32 hash;
+	size_t i;
+
+	if (function == (actionf_p1)P_MobjThinker)
+		type = ((mobj_t *)thinker)->type;
+
+	hash = (UINT32)((size_t)function >> 4) * 2654435761u + (UINT32)type;
+	hash ^= hash >> 15;
+
+	for (i = 0; i < THINKERGROUPHASHSIZE; i++, hash++)
+	{
+		thinkergroup_t *g = &thinkergroups[hash & (THINKERGROUPHASHSIZE - 1)];
+
+		if (g->stamp != groupstamp)
+		{
+			// Keep the table at most half full
+			if (*numgroups >= THINKERGROUPHASHSIZE/2)
+				return UINT32_MAX;
+
+			g->function = function;
+			g->type = type;
+			g->stamp = groupstamp;
+			g->group = (*numgroups)++;
+			return g->group;
+		}
+
+		if (g->function == function && g->type == type)
+			return g->group;
+	}
+
+	return UINT32_MAX;
+}
+
+// Fills sortedorder with the thinkers of the list, grouped.
+// Returns false if the list can't be sorted; it then must run unsorted.
+static boolean P_SortThinkerList(thinklistnum_t n, size_t *count)
+{
+	thinker_t *th;
+	UINT32 numgroups = 0;
+	size_t i, num = 0;
+	UINT32 g;
+
+	for (th = thlist[n].next; th != &thlist[n]; th = th->next)
+		num++;
+
+	*count = num;
+
+	if (num > sortedorder_max)
+	{
+		sortedorder_max = num + num/2;
+		listorder = Z_Realloc(listorder, sortedorder_max * sizeof (*listorder), PU_STATIC, NULL);
+		listgroups = Z_Realloc(listgroups, sortedorder_max * sizeof (*listgroups), PU_STATIC, NULL);
+		sortedorder = Z_Realloc(sortedorder, sortedorder_max * sizeof (*sortedorder), PU_STATIC, NULL);
+	}
+
+	if (++groupstamp == 0)
+	{
+		memset(thinkergroups, 0, sizeof (thinkergroups));
+		groupstamp = 1;
+	}
+
+	for (i = 0, th = thlist[n].next; th != &thlist[n]; th = th->next, i++)
+	{
+		listorder[i] = th;
+		listgroups[i] = P_GetThinkerGroup(th, &numgroups);
+		if (listgroups[i] == UINT32_MAX)
+			return false;
+	}
+
+	if (numgroups + 1 > groupstarts_max)
+	{
+		groupstarts_max = THINKERGROUPHASHSIZE/2 + 1;
+		groupstarts = Z_Realloc(groupstarts, groupstarts_max * sizeof (*groupstarts), PU_STATIC, NULL);
+	}
+
+	// Counting sort, stable within each group
+	memset(groupstarts, 0, (numgroups + 1) * sizeof (*groupstarts));
+	for (i = 0; i < num; i++)
+		groupstarts[listgroups[i] + 1]++;
+	for (g = 1; g <= numgroups; g++)
+		groupstarts[g] += groupstarts[g - 1];
+	for (i = 0; i < num; i++)
+		sortedorder[groupstarts[listgroups[i]]++] = listorder[i];
+
+	return true;
+}
+
 //
 // P_InitThinkers
 //
@@ -216,6 +369,9 @@ void P_AddThinker(const thinklistnum_t n, thinker_t *thinker)
 	thinker->prev = thlist[n].prev;
 	thlist[n].prev = thinker;
 
+	if (n == sortedlist)
+		P_AddSortedThinker(thinker);
+
 	thinker->references = 0;    // killough 11/98: init reference counter to 0
 	thinker->cachable = n == THINK_MOBJ;
 
@@ -406,6 +562,279 @@ mobj_t *P_SetTarget2(mobj_t **mop, mobj_t *targ
 	return targ;
 }
 
+//
+// Parallel thinker steps (cv_thinkerthreads)
+//
+// Light fades, glowing lights and scrollers spend their tic working out
+// their own next state, then write a light level or texture offsets (or
+// push things around, for carrying scrollers). The first part only reads
+// the thinker itself and at most one shared value: the sector light level
+// for glows, the control sector height for scrollers.
+//
+// Before THINK_MAIN runs, that first part is done for every such thinker
+// on a copy, split over worker threads. The thinkers then run in list
+// order as usual, and each one picks up its precomputed step through
+// P_GetThinkerResult, which only hands it out if neither the thinker nor
+// the shared value it read have changed since; otherwise the thinker just
+// steps itself. Every write to the level still happens serially, in list
+// order, so the outcome is identical to not using threads at all.
+//
+// The worker threads are started the first time they're needed and then
+// wait for work between tics, rather than being spawned every tic.
+//
+
+#define MINPARALLELTHINKERS 256 // below this, starting threads costs more than it saves
+
+typedef struct
+{
+	thinker_t *thinker; // NULL once the result has been used
+	size_t size;
+	fixed_t input; // the shared value the step read
+	thinkerresult_t result;
+	union
+	{
+		thinker_t thinker;
+		lightlevel_t lightfade;
+		glow_t glow;
+		scroll_t scroll;
+	} before, after;
+} parallelthinker_t;
+
+static parallelthinker_t *parallelthinkers = NULL;
+static size_t numparallelthinkers = 0;
+static size_t parallelthinkers_max = 0;
+
+static UINT32 *parallelhash = NULL; // index + 1 into parallelthinkers, 0 if empty
+static size_t parallelhashsize = 0; // power of two
+
+static I_mutex parallelmutex;
+static I_cond paralleldone;
+static I_cond parallelwork;
+static INT32 parallelbusy; // ranges still being stepped
+static UINT32 parallelbatch; // bumped every time there is work to do
+static INT32 parallelactive; // workers taking part in the current batch
+static INT32 parallelworkers; // workers started so far
+static boolean parallelstop; // set when quitting
+
+typedef struct
+{
+	size_t start, end;
+} parallelrange_t;
+
+static parallelrange_t parallelranges[16];
+
+static inline UINT32 P_ParallelHash(thinker_t *thinker)
+{
+	return (UINT32)(((size_t)thinker >> 4) * 2654435761u) & (parallelhashsize - 1);
+}
+
+static void P_StepParallelThinker(parallelthinker_t *pt)
+{
+	void *copy = &pt->after;
+	think_t function = pt->before.thinker.function;
+
+	memcpy(copy, &pt->before, pt->size);
+
+	if (function == (actionf_p1)T_LightFade)
+	{
+		INT16 level;
+		pt->input = 0;
+		pt->result.finished = P_StepLightFade(copy, &level);
+		pt->result.out[0] = level;
+	}
+	else if (function == (actionf_p1)T_Glow)
+	{
+		pt->input = pt->before.glow.sector->lightlevel;
+		pt->result.out[0] = P_StepGlow(copy, (INT16)pt->input);
+	}
+	else // T_Scroll
+	{
+		pt->input = P_ScrollControlHeight(&pt->before.scroll);
+		P_StepScroll(copy, &pt->result.out[0], &pt->result.out[1]);
+	}
+}
+
+static void P_StepParallelRange(parallelrange_t *range)
+{
+	size_t i;
+
+	for (i = range->start; i < range->end; i++)
+		P_StepParallelThinker(&parallelthinkers[i]);
+
+	I_lock_mutex(&parallelmutex);
+	if (--parallelbusy == 0)
+		I_wake_all_cond(&paralleldone);
+	I_unlock_mutex(parallelmutex);
+}
+
+// Body of a worker thread: steps its range of every batch it takes part in.
+static void P_ParallelWorker(void *userdata)
+{
+	const INT32 index = (INT32)(intptr_t)userdata;
+	UINT32 batch = 0;
+
+	for (;;)
+	{
+		I_lock_mutex(&parallelmutex);
+		while (!parallelstop && (batch == parallelbatch || index >= parallelactive))
+		{
+			batch = parallelbatch; // not needed for this one, wait for the next
+			I_hold_cond(&parallelwork, parallelmutex);
+		}
+		if (parallelstop)
+		{
+			I_unlock_mutex(parallelmutex);
+			return;
+		}
+		batch = parallelbatch;
+		I_unlock_mutex(parallelmutex);
+
+		P_StepParallelRange(&parallelranges[index]);
+	}
+}
+
+// Lets the workers return, so I_stop_threads can wait for them.
+static void P_StopParallelWorkers(void)
+{
+	I_lock_mutex(&parallelmutex);
+	parallelstop = true;
+	I_wake_all_cond(&parallelwork);
+	I_unlock_mutex(parallelmutex);
+}
+
+static void P_AddParallelThinker(thinker_t *thinker, size_t size)
+{
+	parallelthinker_t *pt;
+
+	if (numparallelthinkers >= parallelthinkers_max)
+	{
+		parallelthinkers_max = parallelthinkers_max ? parallelthinkers_max * 2 : 1024;
+		parallelthinkers = Z_Realloc(parallelthinkers, parallelthinkers_max * sizeof (*parallelthinkers), PU_STATIC, NULL);
+	}
+
+	pt = &parallelthinkers[numparallelthinkers++];
+	pt->thinker = thinker;
+	pt->size = size;
+	pt->result.finished = false;
+	pt->result.out[0] = pt->result.out[1] = 0;
+	memcpy(&pt->before, thinker, size);
+}
+
+// Steps the eligible thinkers of a list ahead of time.
+static void P_StepThinkersInParallel(thinklistnum_t n)
+{
+	INT32 numthreads = min(cv_thinkerthreads.value, (INT32)(sizeof parallelranges / sizeof *parallelranges) - 1);
+	INT32 i;
+	thinker_t *th;
+	size_t j;
+
+	numparallelthinkers = 0;
+
+	if (numthreads <= 0 || !I_can_thread())
+		return;
+
+	for (th = thlist[n].next; th != &thlist[n]; th = th->next)
+	{
+		if (th->function == (actionf_p1)T_LightFade)
+			P_AddParallelThinker(th, sizeof (lightlevel_t));
+		else if (th->function == (actionf_p1)T_Glow)
+			P_AddParallelThinker(th, sizeof (glow_t));
+		else if (th->function == (actionf_p1)T_Scroll)
+			P_AddParallelThinker(th, sizeof (scroll_t));
+	}
+
+	if (numparallelthinkers < MINPARALLELTHINKERS)
+	{
+		numparallelthinkers = 0;
+		return;
+	}
+
+	if (parallelhashsize < numparallelthinkers * 2)
+	{
+		while (parallelhashsize < numparallelthinkers * 2)
+			parallelhashsize = parallelhashsize ? parallelhashsize * 2 : 2048;
+		parallelhash = Z_Realloc(parallelhash, parallelhashsize * sizeof (*parallelhash), PU_STATIC, NULL);
+	}
+	memset(parallelhash, 0, parallelhashsize * sizeof (*parallelhash));
+
+	for (j = 0; j < numparallelthinkers; j++)
+	{
+		UINT32 h = P_ParallelHash(parallelthinkers[j].thinker);
+		while (parallelhash[h])
+			h = (h + 1) & (parallelhashsize - 1);
+		parallelhash[h] = (UINT32)(j + 1);
+	}
+
+	// Start whichever workers are still missing; they stay for later tics.
+	// Exit functions run last to first, so this one runs before I_stop_threads.
+	while (parallelworkers < numthreads
+		&& I_spawn_thread("thinker-step", P_ParallelWorker, (void *)(intptr_t)parallelworkers))
+	{
+		if (!parallelworkers)
+			I_AddExitFunc(P_StopParallelWorkers);
+		parallelworkers++;
+	}
+	numthreads = min(numthreads, parallelworkers);
+
+	// Workers take the first ranges, this thread takes the last one
+	for (i = 0; i <= numthreads; i++)
+	{
+		parallelranges[i].start = numparallelthinkers * i / (numthreads + 1);
+		parallelranges[i].end = numparallelthinkers * (i + 1) / (numthreads + 1);
+	}
+
+	I_lock_mutex(&parallelmutex);
+	parallelbusy = numthreads + 1;
+	parallelactive = numthreads;
+	parallelbatch++;
+	I_wake_all_cond(&parallelwork);
+	I_unlock_mutex(parallelmutex);
+
+	P_StepParallelRange(&parallelranges[numthreads]);
+
+	I_lock_mutex(&parallelmutex);
+	while (parallelbusy)
+		I_hold_cond(&paralleldone, parallelmutex);
+	I_unlock_mutex(parallelmutex);
+}
+
+/** Hands a thinker the step worked out for it ahead of time, if any.
+  * The thinker's state is updated to what stepping it would have left.
+  *
+  * \param thinker The thinker about to run.
+  * \param input   The current value of the shared state its step reads.
+  * \return The precomputed result, or NULL if the thinker has to step itself.
+  */
+thinkerresult_t *P_GetThinkerResult(thinker_t *thinker, fixed_t input)
+{
+	parallelthinker_t *pt;
+	UINT32 h;
+
+	if (!numparallelthinkers)
+		return NULL;
+
+	for (h = P_ParallelHash(thinker); parallelhash[h]; h = (h + 1) & (parallelhashsize - 1))
+	{
+		pt = &parallelthinkers[parallelhash[h] - 1];
+
+		if (pt->thinker != thinker)
+			continue;
+
+		pt->thinker = NULL; // one use only
+
+		// A thinker freed this tic may have its memory reused by a new one,
+		// which is fine as long as it is the same kind in the same state.
+		if (pt->before.thinker.function != thinker->function || pt->input != input
+		|| memcmp((UINT8 *)thinker + sizeof (thinker_t), (UINT8 *)&pt->before + sizeof (thinker_t), pt->size - sizeof (thinker_t)))
+			return NULL; // something else got to it first
+
+		memcpy((UINT8 *)thinker + sizeof (thinker_t), (UINT8 *)&pt->after + sizeof (thinker_t), pt->size - sizeof (thinker_t));
+		return &pt->result;
+	}
+
+	return NULL;
+}
+
 //
 // P_RunThinkers
 //
@@ -428,19 +857,72 @@ mobj_t *P_SetTarget2(mobj_t **mop, mobj_t *targ
 // Rewritten to delete nodes implicitly, by making currentthinker
 // external and using P_RemoveThinkerDelayed() implicitly.
 //
-static inline void P_RunThinkers(void)
+// With cv_sortthinkers, each list runs grouped by thinker type instead.
+// A thinker is only ever freed by P_RemoveThinkerDelayed on its own turn,
+// so the snapshot taken by P_SortThinkerList stays valid while it runs.
+//
+static inline void P_RunSortedThinkers(thinklistnum_t n)
+{
+	size_t i, count;
+
+	if (!P_SortThinkerList(n, &count))
+	{
+		for (currentthinker = thlist[n].next; currentthinker != &thlist[n]; currentthinker = currentthinker->next)
+			currentthinker->function(currentthinker);
+		return;
+	}
+
+	sortedlist = n;
+	numpendingthinkers = 0;
+
+	for (i = 0; i < count; i++)
+	{
+		currentthinker = sortedorder[i];
+#ifdef PARANOIA
+		I_Assert(currentthinker->function != NULL);
+#endif
+		currentthinker->function(currentthinker);
+	}
+
+	// Thinkers spawned meanwhile; running them may spawn even more.
+	for (i = 0; i < numpendingthinkers; i++)
+	{
+		currentthinker = pendingthinkers[i];
+		currentthinker->function(currentthinker);
+	}
+
+	sortedlist = NUM_THINKERLISTS;
+	numpendingthinkers = 0;
+}
+
+static void P_RunThinkers(void)
 {
 	size_t i;
 	for (i = 0; i < NUM_THINKERLISTS; i++)
 	{
 		PS_START_TIMING(ps_thlist_times[i]);
-		for (currentthinker = thlist[i].next; currentthinker != &thlist[i]; currentthinker = currentthinker->next)
+		if (i == THINK_MOBJ)
+		{
+			LUA_HookMobjThinkerBatch();
+			P_SetSightCacheActive(true);
+		}
+		if (i == THINK_MAIN)
+			P_StepThinkersInParallel(i);
+		if (cv_sortthinkers.value)
+			P_RunSortedThinkers(i);
+		else
 		{
+			for (currentthinker = thlist[i].next; currentthinker != &thlist[i]; currentthinker = currentthinker->next)
+			{
 #ifdef PARANOIA
-			I_Assert(currentthinker->function != NULL);
+				I_Assert(currentthinker->function != NULL);
 #endif
-			currentthinker->function(currentthinker);
+				currentthinker->function(currentthinker);
+			}
 		}
+		if (i == THINK_MOBJ)
+			P_SetSightCacheActive(false);
+		numparallelthinkers = 0;
 		PS_STOP_TIMING(ps_thlist_times[i]);
 	}
 
@@ -769,6 +1251,8 @@ void P_Ticker(boolean run)
 
 		ps_lua_mobjhooks.value.i = 0;
 		ps_checkposition_calls.value.i = 0;
+		ps_sightcache_hits.value.i = 0;
+		ps_sightcache_misses.value.i = 0;
 
 		PS_START_TIMING(ps_lua_prethinkframe_time);
 		LUA_HookPreThinkFrame();
@@ -808,6 +1292,10 @@ void P_Ticker(boolean run)
 		PS_START_TIMING(ps_lua_thinkframe_time);
 		LUA_HookThinkFrame();
 		PS_STOP_TIMING(ps_lua_thinkframe_time);
+
+		PS_START_TIMING(ps_lua_tasks_time);
+		LUA_RunTasks();
+		PS_STOP_TIMING(ps_lua_tasks_time);
 	}
 
 	// Run shield positioning
@@ -961,6 +1449,7 @@ void P_PreTicker(INT32 frames)
 				P_PlayerAfterThink(&players[i]);
 
 		LUA_HookThinkFrame();
+		LUA_RunTasks();
 
 		// Run shield positioning
 		P_RunShields();
@@ -31,6 +31,15 @@ void P_PreTicker(INT32 frames);
 void P_DoTeamscrambling(void);
 void P_RemoveThinkerDelayed(thinker_t *thinker); //killed
 
+// A thinker's step for this tic, worked out ahead of time by a worker thread
+typedef struct
+{
+	fixed_t out[2];
+	boolean finished;
+} thinkerresult_t;
+
+thinkerresult_t *P_GetThinkerResult(thinker_t *thinker, fixed_t input);
+
 mobj_t *P_SetTarget2(mobj_t **mo, mobj_t *target
 #ifdef PARANOIA
 		, const char *source_file, int source_line
@@ -99,6 +99,7 @@ static boolean onground;
 //
 void P_Thrust(mobj_t *mo, angle_t angle, fixed_t move)
 {
+	P_WakeMobj(mo);
 	angle >>= ANGLETOFINESHIFT;
 
 	mo->momx += FixedMul(move, FINECOSINE(angle));
@@ -109,6 +110,7 @@ void P_Thrust(mobj_t *mo, angle_t angle, fixed_t move)
 
 void P_ThrustEvenIn2D(mobj_t *mo, angle_t angle, fixed_t move)
 {
+	P_WakeMobj(mo);
 	angle >>= ANGLETOFINESHIFT;
 
 	mo->momx += FixedMul(move, FINECOSINE(angle));
@@ -154,6 +156,7 @@ void P_VectorInstaThrust(fixed_t xa, fixed_t xb, fixed_t xc, fixed_t ya, fixed_t
 //
 void P_InstaThrust(mobj_t *mo, angle_t angle, fixed_t move)
 {
+	P_WakeMobj(mo);
 	angle >>= ANGLETOFINESHIFT;
 
 	mo->momx = FixedMul(move, FINECOSINE(angle));
@@ -164,6 +167,7 @@ void P_InstaThrust(mobj_t *mo, angle_t angle, fixed_t move)
 
 void P_InstaThrustEvenIn2D(mobj_t *mo, angle_t angle, fixed_t move)
 {
+	P_WakeMobj(mo);
 	angle >>= ANGLETOFINESHIFT;
 
 	mo->momx = FixedMul(move, FINECOSINE(angle));
@@ -1818,6 +1822,8 @@ boolean P_IsObjectOnGround(mobj_t *mo)
 //
 void P_SetObjectMomZ(mobj_t *mo, fixed_t value, boolean relative)
 {
+	P_WakeMobj(mo);
+
 	if (mo->eflags & MFE_VERTICALFLIP)
 		value = -value;
 
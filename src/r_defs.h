@@ -514,6 +514,7 @@ typedef struct sector_s
 	lightlist_t *lightlist;
 	INT32 numlights;
 	boolean moved;
+	struct fofheights_s *fofheights; // cached FOF heights for P_FloorzAtPos/P_CeilingzAtPos
 
 	// per-sector colormaps!
 	extracolormap_t *extra_colormap;
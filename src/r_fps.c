@@ -18,6 +18,7 @@
 #include "g_game.h"
 #include "i_video.h"
 #include "r_plane.h"
+#include "p_local.h" // P_InvalidateFOFHeights
 #include "p_spec.h"
 #include "p_slopes.h"
 #include "r_state.h"
@@ -692,6 +693,8 @@ void R_ApplyLevelInterpolators(fixed_t frac)
 			break;
 		}
 	}
+
+	P_InvalidateFOFHeights(); // planes are at their interpolated heights now
 }
 
 void R_RestoreLevelInterpolators(void)
@@ -753,6 +756,8 @@ void R_RestoreLevelInterpolators(void)
 			break;
 		}
 	}
+
+	P_InvalidateFOFHeights(); // and back at their real ones
 }
 
 void R_DestroyLevelInterpolators(thinker_t *thinker)